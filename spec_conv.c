@@ -1,1844 +1,7095 @@
-#include <stdio.h>
-#include <string.h>
-#include <stdlib.h>
-#include <unistd.h>
-#include <fcntl.h>
-#include <ctype.h>
-#include <math.h>
-#include <sys/stat.h>
-#include <sys/types.h>
-#include <termios.h>
-
-#define CHMAX 	  32768	/*max number of channels in spectra*/
-#define MAXCOLS   3     /*max. number data columns in input spectrum*/
-#define MXNUMDIG  3     /*max number of digits for the number of multi spectra
-                            that can be extracted. i.e. 3 ==> 999 spectra*/
-#define NUMOPT    11    /*number of options*/
-#define CHLEN     120   /*character length of filename arrays*/
-                            
-/* Carl Wheldon May 2003 */
-/* Lastest up-date May 2025*/
-
-/* To compile:
-gcc spec_conv.c -Wall -pedantic -o spec_conv -lm -O2
-*/
-
-/*%%%%% A program to convert between different spectra formats %%%%%*/
-/* To add a new option:
-    add input extension and format to exti[] and fmti[],
-    add output extension and format to ext[] and fmt[],
-    edit get_mode(), read_spec() and write_spec(),
-    and add md (i.e. mode number) to relevant point in main().*/
-
-/*structure of the radware header as written to/read from a spectrum*/
-struct radheader {
-    unsigned int q1;
-    char    	 name[8];
-    unsigned int channels;
-    unsigned int q2;
-    unsigned int q3;
-    unsigned int q4;
-    unsigned int q5;
-    unsigned int size;
-} radheader;
-
-/*structure of the radware trailer*/
-struct radtrailer {
-    unsigned int size;
-} radtrailer;
-
-/*structure of the Ortec Maestro header as written to/read from a spectrum*/
-struct  maest_header {
-    short int q1;           /*must be one*/
-    short int q2;           /*MCA/det number*/
-    short int q3;           /*segment number*/
-    short int q4;           /*ascii second of start time*/
-    unsigned int real;      /*real time (increments of 20 ms)*/
-    unsigned int lve;       /*live time (increments of 20 ms)*/
-    char dt[8];             /*Start date as ASCII DDMMMYY*
-                              The * character should be ignored if it is not
-                              a "1". If it is a "1", it indicates the data is
-                              after the year 2000.*/
-    char sttm[4];           /*start time as ASCII HHMM or binary zeros,
-                                if not known*/
-    short int off;          /*channel offset of data*/
-    short int channels;     /*length of data (channels)*/
-} maest_header;
-
-/*structure of the Ortec Maestro header as written to/read from a spectrum*/
-struct  maest_trailer {
-    short int t1;           /*must be 102*/
-    short int t2;           /*reserved???*/
-    float     g[3];         /*energy calib coeff offset, gain and quadratic term*/  
-    char      trailer[496]; /*nothing particularly useful in the rest of the trailer*/
-} maest_trailer;
-
-int 	ascii_read(char name[]);
-void 	ascii_write(char name[], int numch);
-void 	chan_num_ext(char fin[], char fout[], int *numch, char ext[]);
-void	check_ext(char fin[], char ext[]);
-int  	col_determ(FILE *file);
-long 	convert_bytes(char name[]);
-int 	cswap4(int decim);
-int 	cswap2(int decim);
-void	decode_mspec_name(char name[], int *set, int *mxsp, int *numch,
-	    int *sz, int bytes);
-void 	file_status(char name[], char ext[], int len);
-int 	genie_read(char name[]);
-void 	get_ans(char ans[], int num);
-void 	get_line(char ans[], int len);
-void    get_line_file(FILE *file, char ans[], int len);
-int 	get_mode(int md);
-void 	get_pars(float pars[], int num);
-void    get_pars_file(FILE *file, float pars[], int num);
-void 	get_val(float *val);
-void 	itoa(int n, char s[]);
-int 	maestro_read(char name[]);
-void 	num_fname(char name[], int num);
-int 	rad_read(char name[]);
-void 	rad_write(char name[], int numch);
-int 	read_lst(char inname[], int lst);
-int     read_spec(char name[], int md);
-void 	reverse(char s[]);
-void 	set_ext(char name[], char ext[]);
-void 	skip_hash(FILE *file);
-void    skip_lines(FILE *file, int lns);
-void    store_colours();
-void 	swapb2(char *buf);
-void 	swapb4(char *buf);
-void    write_spec(char name[], int numch, int md);
-void 	xtrack_read(char name[], int *numch, int mxsp, int sz, int nsp,
-	    int flg);
-void 	xtrack_write(char name[], int numch);
-        
-float spectrum[CHMAX], gain[3];
-int md;
-char ext[NUMOPT][11], exti[NUMOPT][11], fmti[NUMOPT][14], fmt[NUMOPT][14];
-char clr[10][12];
-/* ++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
-/* ++++++++++++++++++++++++++++++++++ MAIN ++++++++++++++++++++++++++++++++++ */
-/* ++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
-int main(int argc, char *argv[])
-{
-    extern float spectrum[CHMAX], gain[3];
-    extern int	md;
-    extern char ext[NUMOPT][11], exti[NUMOPT][11]; 
-    extern char fmti[NUMOPT][14], fmt[NUMOPT][14];
-    float   spbuf[CHMAX], res = 0.0, cal_chan = 0.0, calib = 2.000, tmpf = -1.0;
-    long    bytes = 0;
-    int     flg = 1, fn = 0, i = 0, j = 0, lst = 3, mxsp = 0, nsp = -1;
-    int     numch = CHMAX, set = 1, sz = 4;
-    char    inname[CHLEN] = "", outname[CHLEN] = "", ans[CHLEN] = "";
-    struct  stat statbuf;
-    FILE    *fl;
-    
-    /*store colours*/
-    store_colours();
-    
-    /*fill input extension arrays and input format arrays.
-        Note strlen+1 is used to terminate strings*/
-    strncpy(exti[0], ".spe", 5);         strncpy(fmti[0], "RadWare", 8);
-    strncpy(exti[1], ".txt", 5);         strncpy(fmti[1], "Ascii", 6);
-    strncpy(exti[2], ".txt", 5);         strncpy(fmti[2], "Ascii", 6);
-    strncpy(exti[3], ".Chn", 5);         strncpy(fmti[3], "Maestro_Chn", 12);
-    strncpy(exti[4], ".Chn", 5);         strncpy(fmti[4], "Maestro_Chn", 12);
-    strncpy(exti[5], ".spec", 6);        strncpy(fmti[5], "Xtrack", 7);
-    strncpy(exti[6], ".spec", 6);        strncpy(fmti[6], "Xtrack", 7);
-    strncpy(exti[7], ".IEC", 5);         strncpy(fmti[7], "GENIE", 6);
-    strncpy(exti[8], ".Spe", 5);         strncpy(fmti[8], "Maestro_Spe", 12);
-    strncpy(exti[9], ".Spe", 5);         strncpy(fmti[9], "Maestro_Spe", 12);
-    strncpy(exti[NUMOPT-1], ".spe", 5);  strncpy(fmti[NUMOPT-1], "RadWare", 8);
-    
-    /*fill output extension arrays*/
-    strncpy(ext[0], ".txt", 5);                 strncpy(fmt[0], "Ascii", 6);
-    strncpy(ext[1], ".spe", 5);                 strncpy(fmt[1], "RadWare", 8);
-    strncpy(ext[2], ".spec", 6);                strncpy(fmt[2], "Xtrack", 7);
-    strncpy(ext[3], ".txt", 5);                 strncpy(fmt[3], "Ascii", 6);
-    strncpy(ext[4], ".spe", 5);                 strncpy(fmt[4], "RadWare", 8);
-    strncpy(ext[5], ".txt", 5);                 strncpy(fmt[5], "Ascii", 6);
-    strncpy(ext[6], ".spe", 5);                 strncpy(fmt[6], "RadWare", 8);
-    strncpy(ext[7], ".spe", 5);                 strncpy(fmt[7], "RadWare", 8);
-    strncpy(ext[8], ".spe", 5);                 strncpy(fmt[8], "RadWare", 8);
-    strncpy(ext[9], ".txt", 5);                 strncpy(fmt[9], "Ascii", 6);
-    strncpy(ext[NUMOPT-1], "_mtchd.spe", 11);   strncpy(fmt[NUMOPT-1], "RadWare", 8);
-    
-    
-    md = 0;
-    for (i = 0; i < 3; i++) gain[i] = 0.0;
-    i = (int)pow(10,MXNUMDIG) - 1;
-    
-    printf("\n \t \t     *****Welcome to SPEC_CONV*****\n"
-	    "\tThis program converts spectra between RadWare, Ascii,\n"
-	    "\tXtrack (GASPWARE) and Ortec (binary Chn & ASCII Spe) formats,\n"
-            "\tincluding multiple-spectra (<%d) Xtrack files, e.g. from AGATA.\n"
-	    "\tand can gainmatch spectra.\n"
-	    "\t(Ascii means (y) or (x y) data starting from channel zero)\n"
-	    "\tComment lines starting with # are ignored at the front of\n"
-	    "\tascii spectra. The 1 or 2 col. format is auto-detected.\n\n",i); 
-
-/*    printf("    Input ext   Output ext  Format\n");
-    for (i = 0; i < NUMOPT; i++)
-        printf("    %-11s %-11s %-14s\n",exti[i], ext[i], fmti[i]);
-    printf("\n");*/
-       
-    /*argv[i] is the ith argument, i.e. first is the program name*/
-    if ( argc > 2 || (argc == 2 && (stat(argv[1], &statbuf))) )
-    {
-	printf("\nUnrecognised arguments...usage: spec_conv\n"
-		" or: spec_conv SpectrumFileName\n");
-	if (argc == 2) printf(" ***File %s does not exist\n",argv[1]);
-	return -1;
-    }
-    else if (argc == 2)
-    {
-        strcpy(inname,argv[1]);
-	/*printf("Filename = %s\n",inname);*/
-	lst = 2;
-        /*read first non-comment line of file...
-            if it's the name of an existing file assume a list file*/
-    	if ((fl = fopen(inname, "r" )) == NULL)
-    	{
-    	    printf("Cannot open file: %s \n", inname);
-    	    return -1;			
-    	}
-        skip_hash(fl);
-        if ( (i = fscanf(fl, "%s", ans)) == 1)
-        {
-           if ( ! stat(ans, &statbuf))
-           {
-              /*file exists...assuming list file*/
-              lst = -1;
-              fclose(fl);
-              printf("List filename = %s\n",inname);
-           }
-           else printf("Spectrum filename = %s\n",inname);
-        }
-    }
-    
-    if ( (md = get_mode(md)) == 0) return 0;
-    
-    while (lst == 3)
-    {        
-	printf("Read spectrum names from list file (y/n) \n");
-	get_ans(ans,1);
-	if (ans[0] == 'y' || ans[0] == 'Y') lst = 1;
-	else if (ans[0] == 'n' || ans[0] == 'N') lst = 0;
-    }    
-
-    /* simple spectrum read/write */
-    if ( (md >= 1 && md <= 5) || md == 8 || md == 9 || md == 10)
-    {
-	while (flg == 1)
-	{
-	    numch = CHMAX;
-	    /*if a list file*/
-	    if (lst == 1 || lst == -1) fn = read_lst(inname,lst);
-	    else if (lst == 0)
-	    {
-    	    	printf("Type %s filename inc. extension (eg %s):\n",
-                        fmti[md-1],exti[md-1]);
-	    	get_line(inname, CHLEN);
-	    }
-	    if (lst != 1 && lst != -1) flg = -1;
-            
-	    if (fn == -1) return 0;
-            
-	    /*zero spectrum array*/    	
-    	    for (i = 0; i < CHMAX; i++) spectrum[i] = 0.0;
-    	    	
-    	    /*read spectrum file*/
-	    if ( (numch = read_spec(inname, md)) < 0)
-            {
-		printf("Error, no. channels:%d ...Exiting\n", numch);
-                return -1;
-            }
-	    /* if channels is not multiple of 4096 or <1024, ask for length*/
-    	    chan_num_ext(inname, outname, &numch, ext[md-1]);
-
-	    strcpy(outname,inname);
-    	    set_ext(outname, ext[md-1]);
-    	    /*check file status*/
-    	    file_status(outname, ext[md-1], CHLEN);
-    	                
-    	    printf(" %s", inname);
-	    write_spec(outname, numch, md);
-	}
-    }/*END simple spectrum read/write */        
-            
-    /*Xtrackn format options*/    
-    if ( md == 6 || md == 7 )
-    {
-	while (flg == 1)
-	{
-	    /*reset some parameters*/
-	    if (mxsp < 1)
-	    {
-		numch = CHMAX;
-		set = 1;
-	    }
-	    /*if a list file*/
-	    if ( (lst == 1 || lst == -1) && mxsp <= 1) fn = read_lst(inname,lst);
-	    else if (lst == 0 && nsp == -1)
-	    {
-    	    	printf("Type %s filename inc. extension (eg %s):\n",
-                        fmti[md-1],exti[md-1]);
-	    	get_line(inname, CHLEN);
-	    }
-	    if (fn == -1) return 0;
-	    
-	    strcpy(outname, inname);
-	    if (lst != 1) flg = -1;
-	    
-	    /*modes 6 and 7 allow for extraction/conversion of
-	    	multiple CHMAX channel spectrum in 1 file*/
-	    check_ext(inname, exti[md-1]);
-    	    /*get and print file size*/
-     	    if (mxsp <= 1) bytes = convert_bytes(inname);
-	
-	    /*check file name for "__" surrounding mult. spec info*/
-            if ( mxsp < 1 && strchr(inname,'_') && ! strncmp( strchr(inname,'_'), "__", 2 ) )
-	        decode_mspec_name(inname, &set, &mxsp, &numch, &sz, bytes);
-
-	    /*for a standard spectrum check numch is compatible with
-	        the filesize*/
-    	    while ( mxsp < 1 && 
-	        (mxsp = (int)( bytes/(numch*sizeof(unsigned int)) )) < 1
-	            && numch > 50) numch /= 2;
-    
-    	    if ( mxsp > 1 && nsp == -1)
-    	    {
-	        while (1)
-	        {
-	            printf("Enter spectrum number you require"
-	                " (0-%d, %d for all)\n",mxsp-1,mxsp);
-	            get_val(&tmpf);
-	            nsp = (int)tmpf;
-	            j = 0;
-	            if (nsp >= 0 && nsp <= mxsp) break;
-	        }
-    	    }
-    	    else if (mxsp == 1)
-    	    {
-	        nsp = 0;
-	        j = nsp;
-    	    }
-	
-    	    /*set output filename*/
-/*    	    if (mxsp > 1 && nsp == mxsp)*/
-    	    if (mxsp > 1)
-	    {
-	        if (nsp != mxsp) j = nsp;
-	        flg = 1;
-	        strcpy(outname,inname);
-                num_fname(outname, j);
-	    }
-	    
-	    /*zero spectrum array*/    	
-    	    for (i = 0; i < CHMAX; i++) spectrum[i] = 0.0;
-            
-    	    if (numch > 50) xtrack_read(inname, &numch, mxsp, sz, j, flg);
-            
-	    j++;
-	    /*reset parameters if last spectrum read*/
-	    if ( ( (mxsp > 1) && ((nsp == mxsp && j == mxsp)
-	            || (nsp != mxsp))) || mxsp == 1)
-	    {
-	        mxsp = 0;
-	        nsp = -1;
-	        /*only break while loop if no more spectra to process*/
-	        if (lst != 1) flg = -1;
-	    }
-	    
-	    if (numch <= 0 || numch > CHMAX)
-	    {
-		printf("Error, no. channels: %d ...Exiting\n", numch);
-		return -1;
-	    }
-	    	    
-    	    set_ext(outname, ext[md-1]);
-    	    /*check file status*/
-    	    file_status(outname, ext[md-1], CHLEN);
-    	    
-    	    printf(" %s", inname);
-	    write_spec(outname, numch, md);
-    	}
-    } /*END Xtrackn ==> format options*/ 
-        
-    /* Read in RadWare spectrum, GAINMATCH, and output as RadWare spectrum */
-    if (md == NUMOPT)
-    {
-        printf("md = %d\n",md);
-	while (flg == 1)
-	{
-	    numch = CHMAX;
-	    /*if a list file i.e. extension not .spe*/
-            /*strcmp returns zero if identical, i.e. if not equal to NULL*/
-            if (lst == 2 && strcmp( (strrchr(inname,'.')), exti[NUMOPT-1] ) )
-                  lst = -1;
-	    
-            if (lst == 1 || lst == -1) fn = read_lst(inname,lst);
-	    else if (lst == 0 || lst == 2)
-	    {
-		flg = -1;
-		if (lst == 0)
-		{
-    	    	    printf("Type %s filename inc. extension (eg %s):\n",
-                        fmti[md-1],exti[md-1]);
-	    	    get_line(inname, CHLEN);
-		}
-	    	printf("Enter up to 3 gainmatching coeffs. (A0 A1 A2):\n");
-		get_pars(gain,3);
-	    	printf("A0 = %e, A1 = %e, A2 = %e\n",
-			gain[0], gain[1], gain[2]);
-	    }
-	    if (fn == -1) return 0;
-	    
-	    if (fn == 1 || lst != 1)
-	    {
-		if (gain[1] != 0.0) calib = fabs(1.0/gain[1]);
-		else calib = 1.0;
-	    	printf("You can choose to multiply the coeffs by a"
-	    	    " constant factor (e.g. |1/%.2f| = %.2f).\n"
-                    "Then your keV/channel for the matched spectra will be"
-                    " 1/(factor).\n"
-                    "E.g. for a factor of 2.0 the matched spectra will have 0.5 keV/channel\n"
-		    "Enter value for factor [<Enter> for 1.0]\n",gain[1],calib);
-	    	get_val(&calib);
-	    	if (calib <= 0.0)
-	    	{
-	    	    printf("Mult. factor = 0.0 ==> reset to 1.0\n");
-	    	    calib = 1.0;
-	    	}
-	    }
-	    /*zero spectra arrays*/	    	
-    	    for (i = 0; i < CHMAX; i++)
-	    {
-		spectrum[i] = 0.0;
-		spbuf[i] = 0.0;
-	    }
-    	    					
-	    gain[0] = calib*gain[0];
-	    gain[1] = calib*gain[1];
-	    gain[2] = calib*gain[2];
-	    if (calib != 1.0) printf("A0 = %e, A1 = %e, A2 = %e\n",
-			gain[0], gain[1], gain[2]);
-	    
-    	    /*read spectrum file*/
-	    if ( (numch = read_spec(inname, md)) < 0)
-            {
-		printf("Error, no. channels:%d ...Exiting\n", numch);
-                return -1;
-            }
-	    
-            /*fill spectrum array*/
-	    for (j = 0; j < numch; j++)
-    	    {
-	    	cal_chan = gain[0] + j*gain[1] + j*j*gain[2];
-		/*do nothing with counts in channels out of range*/
-	    	if ( ( (int)cal_chan ) < 0 || ( (int)cal_chan ) >= numch) ;
-	    	else
-	    	{
-    	    	    res =  cal_chan - (float)( (int)cal_chan );
-		    spbuf[(int)cal_chan] += spectrum[j]*(1.0-res);
-		    spbuf[((int)cal_chan) + 1] += spectrum[j]*res;	    
-	    	}
-		spectrum[j] = 0.0;
-    	    }
-	    
-	    /*round counts in spectrum array*/
-    	    for (j = 0; j < numch; j++)   	    	
- 	    	spectrum[j] = (float)( (int)(spbuf[j] + 0.5) );
-
-	    strcpy(outname,inname);
-    	    set_ext(outname, ext[md-1]);
-    	    /*check file status*/
-    	    file_status(outname, ext[md-1], CHLEN);
-    	    
-    	    printf(" %s", inname);
-	    write_spec(outname, numch, md);
-    	}
-    } /* END Gainmatch RadWare spectrum and output as RadWare */
-                     
-    return 0;
-} /*END main()*/
-
-/*==========================================================================*/
-/* ascii_read: read an ASCII format spectrum	    	    	    	    */
-/****************************************************************************/
-int ascii_read(char name[])
-{
-    float   rd = 0, rlt[2];
-    int     ascii = 0, chan = 0, res = 0, lchan = CHMAX;
-    char    ans[CHLEN] = "";
-    FILE    *fsp;
-     
-    /*opens ascii file*/
-    if ((fsp = fopen(name, "r" )) == NULL)
-    {
-    	printf("Cannot open file: %s \n", name);
-    	return -1;
-    }
-    
-    /*for Maestro ASCII format spectrum decode header*/
-    if (md == 9 || md == 10)
-    {
-        /*skip the first 7 header lines*/
-        skip_lines(fsp, 7);
-        /*get and print date*/
-        get_line_file(fsp, ans, CHLEN);
-        printf("%sSpectrum date: %s%s\n",clr[2],ans,clr[0]);
-        
-        /*get and print real/live time*/
-        skip_lines(fsp, 1);
-        rlt[0] = 0.0; rlt[1] = 0.0;
-        get_pars_file(fsp, rlt, 2);
-        printf("    %sLive time: %.2f s, Real time %.2f s%s\n",
-            clr[2],rlt[0],rlt[1],clr[0]);
-        
-        /*get channel number*/
-        skip_lines(fsp, 1);
-        rlt[0] = 0.0; rlt[1] = 0.0;
-        get_pars_file(fsp, rlt, 2);
-        printf("    %sFirst chan: %d, last chan %d%s\n",
-            clr[2],(int)rlt[0],(int)rlt[1],clr[0]);
-    }
-    
-    /*Determine if spectrum is 1 or 2 col. ascii format & set 1 col flag*/
-    if ( (ascii = col_determ(fsp)) == 0)
-    {
-	printf("%s***No suitable data in file %s; Exiting...%s\n\n",
-                clr[1],name,clr[0]);
-	return -1;
-    }  
-    printf("Ascii %d column format....", ascii);    
-    /*End of deciding if spectrum is 1 or 2 column ascii format*/
-    
-    for (chan = 0; (((md != 9 && md != 10) && chan < CHMAX) || ((md == 9 || md == 10) && chan < (rlt[1]+1))); chan++)
-    { 
-/*    	res = fscanf(fsp, "%f %f", &rd, &spectrum[chan]); */
-	if (ascii == 2)    /*only for two column data*/
-	{
-    	    res = fscanf(fsp, "%f", &rd);
-	    chan = (int) rd;
-	}
-    	res = fscanf(fsp, "%f\n", &spectrum[chan]);
-	switch (res)
-	{
-	    case 0:
-	    {
-	    	printf("\nchan= %d, spec[chan]= %f\n", chan,
-		    	spectrum[chan]);
-    	    	printf("Read error occurred for file: %s\n", name);
-                /*close ascii file*/
-	    	fclose(fsp);
-	    	return -1;
-	    }
-	    case EOF:
-	    {
-	    	if (chan < CHMAX)
-		{
-		    /*increment chan because chan starts from zero. This is
-		    because of line: chan = (int) rd;*/
-		    if (ascii == 2) chan += 1;
-	    	    printf("Reached EOF after reading chan %d \n", chan);
-		    if (chan == 0)
-		    {
-			printf("\n*******Incorrect file format*******\n");
-			printf("....Exiting....\n\n");
-			return -1;
-		    }
-		}
-		lchan = chan;
-                /*now set chan = CHMAX to exit for() loop*/
-	    	chan = CHMAX;
-    	    	break;
-	    }
-	    default:
-	    {
-/*	    	if (chan == 0) printf("Reading ascii spectrum.......\n");*/
-	    	break;
-    	    }
-    	}
-    }
-    /*for Maestro EOF not reached as there is a trailer*/
-    if (md == 9 || md == 10) lchan = rlt[1] + 1;
-    chan = lchan;
-    
-    /*read trailer for Maestro_Spe formt*/
-    if (md == 9 || md == 10)
-    {
-        printf("Reached EOF after reading chan %d \n", chan);
-        /*skip_lines(fsp, 10);*/
-        /*trailer is of varying length depending on ROIs etc.
-          search for energy calibration indicated by $MCA_CAL
-          followed by a line with the integer no. of coefficients
-          and a second line with the coefficients themselves*/
-
-        while (strncmp(ans, "$MCA_CAL", 8) )
-        {
-            get_line_file(fsp, ans, CHLEN);
-            /*printf("ans:%s:\n",ans);*/
-        }
-        /*strcmp returns zero if identical, i.e. if not equal to NULL*/
-        if (! strncmp(ans, "$MCA_CAL", 8))
-        {
-            get_line_file(fsp, ans, CHLEN);
-            get_line_file(fsp, ans, CHLEN);
-            printf("Maestro calibration coefficients: %s\n\n",ans);
-        }
-    }
-    fclose(fsp); 
-    return (chan);
-} /*END ascii_read()*/
-
-/*==========================================================================*/
-/* ascii_write: write an ASCII format spectrum	    	    	    	    */
-/****************************************************************************/
-void ascii_write(char name[], int numch)
-{
-    int j;
-    FILE *fasc;
-    /*open .txt file*/
-    if ( (fasc = fopen(name, "w" )) == NULL)
-    {
-        printf("Cannot open file: %s \n", name);
-        return ; 
-    }
-   
-    /*write .txt file using floats*/
-    for (j = 0; j < numch; j++) fprintf(fasc, "%d %.5f\n", j, spectrum[j]);
-    
-    printf(" ==> %s %d chs.\n", name, numch);
-
-    fclose(fasc);
-} /*END ascii_write()*/
-
-/*==========================================================================*/
-/*Puts spectrum length in filename before ext 	    	    	    	    */
-/****************************************************************************/
-void chan_num_ext(char fin[], char fout[], int *numch, char ext[])
-{
-    float tmpf = 0.0;
-    int force = 0, i;
-    char buf[20];
-    char ans[20];
-
-    strcpy(fout,fin);
-    set_ext(fout, ext);
-    
-    if ( ( (*numch) < 2048) || ( ((*numch))%1024 != 0) )
-    {
-    	while (force == 0)
-    	{
-    	    printf("Would you like to force the length of the"
-    		" spectrum (y/n)?\n");
-	    get_ans(ans,1);
-    	    if (ans[0] == 'y' || ans[0] == 'Y')
-    	    {
-    		printf("Enter length in channels (max.%d) eg 8192\n"
-    		"(Enter only multiples of 1024 channels)\n",CHMAX);
-    		get_val(&tmpf);
-		*numch = (int)tmpf;
-    		if ( (*numch%1024 == 0) &&  (*numch < CHMAX) )
-    		{
-    		    force = 1;
-    		    break;
-    		}
-    		else printf("Length entered is not a multiple of 1024"
-    			" or >%d\n",CHMAX);
-    	    }
-    	    else if (ans[0] == 'n' || ans[0] == 'N')
-    	    {
-    		force = 1;
-    		break;
-    	    }
-    	}
-    }
-    /*If not an xtrack spectrum, return current filename*/
-    /*enters if statement if equal to NULL..strcmp returns zero if identical*/
-    if ( strcmp(ext,".spec") )
-	return ;
-    
-    /*if it is an xtrack spectrum, construct new file extension*/
-    i = 0;
-    itoa(*numch, buf);
-    strncpy(ans+i++, "_", 1);
-    strncpy(ans+i++, buf, 1);
-    if (*numch >= 10000) strncpy(ans+i++, buf+1, 1 );
-    if (*numch < 1000)
-    {
-    	strncpy(ans+i++, buf+1, 1 );
-	strncpy(ans+i++, buf+2, 1 );
-    }
-    else strncpy(ans+i++, "k", 1 );
-    strcpy(ans+i++, ext );
-    strcpy( strrchr(fout, '.'), ans );
-    return ;
-} /*END chan_num_ext()*/
-
-/*==========================================================================*/
-/*check_ext: check file extension is ext 	    	    	    	    	    	    */
-/****************************************************************************/
-void check_ext(char fin[], char ext[])
-{
-    char ans[3];
-    
-    /*strcmp returns zero if identical, i.e. if not equal to NULL*/
-    if ( ! strcmp( (strrchr(fin,'.')), ext ) ) return ;
-    else
-    {	
-	while (1)
-	{
-    	    printf("File extension is not '%s'\n"
-		    "Are you sure this is the correct filename (y/n) ?\n",ext);    	    	      /*no ext found*/
-	    get_ans(ans,1);
-	    if (ans[0] == 'y' || ans[0] == 'Y') return ;
-	    else if (ans[0] == 'n' || ans[0] == 'N')
-	    {
-	    	printf("Enter new file name inc. extension (%s):\n",ext);
-	    	get_line(fin, CHLEN);
-  	    	printf("New filename is: %s \n",fin);
-	    	return ;
-	    }
-	}
-    }
-} /*END check_ext()*/
-
-/*==========================================================================*/
-/* col_determ: find if a file has 1 or 2 column format      	    	    */
-/****************************************************************************/
-int col_determ(FILE *file)
-{
-    int     col = 0, hash = 0, blnk = 0;
-    fpos_t  pos;
-    
-    /*skip comment lines starting with #*/
-    skip_hash(file);
-    
-    /*store current file position in pos*/
-    fgetpos(file, &pos);
-     	   
-    while (1)
-    {
-    	/*read until first digit of first number*/
-    	while ( isdigit(hash = fgetc(file)) == 0 ) ;
-    	
-	col = 1;
-        /*found first digit of first number. read rest of digits*/
-    	/*ignore decimal points*/
-    	while ( (isdigit(hash = fgetc(file)) != 0) || (hash == '.') ) ;
-    	
-        /*push the last character back on the stream*/
-    	ungetc(hash, file);
-    	/*now test characters until end of line*/
-    	while ( (hash = fgetc(file)) != '\n' )
-    	{
-    	    /*if blank space,increment blank counter and continue*/
-    	    if ( (hash == ' ') || (hash == '\t') || (hash == '\r')) blnk++;
-    	    /*check how many columns of numbers are present*/
-            else if ( (isdigit(hash)) == 0 )
-            {
-                printf("%s***Input is not a valid data file."
-                        " Illegal characters found.%s\n",clr[1],clr[0]);
-                col = 0;
-                return 0;
-            }
-    	    /*if character is a digit*/
-    	    /*check how many columns of numbers are present*/
-    	    else if ( (isdigit(hash)) != 0 )
-    	    {
-    		/*if number increment col flag*/
-    		if (blnk > 0) col++;
-    		
-   		/*otherwise if > MAXCOLS columns set 1 col. flag
-                    and hope for best*/
-    		if ( (blnk != 0) && (col > MAXCOLS) )
-    		{
-    		    col = 1;
-    		    break;
-    		}
-    		/*reset blank counter to zero*/
-    		blnk = 0;
-    		/*read rest of digits*/
-    		while ( (isdigit(hash = fgetc(file)) != 0) || (hash == '.') ) ;
-    		
-                /*push the last character back on the stream*/
-    		ungetc(hash, file);
-    	    }
-    	}
-    	break;
-    }
-    /*reset file position to start of data*/
-    fsetpos(file, &pos);
-    return col;
-} /*END col_determ()*/
-
-/*==========================================================================*/
-/*convert_bytes: convert bytes into Kb, Mb, etc     	    	    	    */
-/****************************************************************************/
-long convert_bytes(char name[])
-{
-    float sz;
-    int i;
-    char bye[4][2];
-    struct stat stbuf;
-    
-    for (i = 0; i < 3; i++)
-    {
-	bye[i][0] = (char)0;
-	bye[i][1] = (char)0;
-    }
-    strncpy(bye[0],"b",2);
-    strncpy(bye[1],"Kb",2);
-    strncpy(bye[2],"Mb",2);
-    strncpy(bye[3],"Gb",2);
-    
-    stat(name, &stbuf);
-    sz = (float)stbuf.st_size;
-    i = 0;
-    while ( sz >= 1024.0 )
-    {
-	sz /= 1024;
-	i++;
-    }
-    printf("\n File size: %ld bytes (%.1f %c%c)\n",
-	    (long)stbuf.st_size,sz,bye[i][0],bye[i][1]);
-    return (long)stbuf.st_size;
-} /*END convert_bytes()*/
-
-/*==========================================================================*/
-/* cswap2: swap bits of a 2 byte number     	    	    	    	    */
-/****************************************************************************/
-int cswap2(int decim)
-{
-    int i, j, max = 17;
-    char bin[17];
-    int swapped = 0;
-    
-    for (i = 1; i >= 0; --i)
-    {
-	for (j = 0; j < (max-1)/2; ++j)
-	{
-    	    if (decim & 0x8000) bin[i*8+j] = '1';
-	    else bin[i*8+j] = '0';
-	    
-	    decim <<= 1;
-/*	    printf(" i*8+j = %d \n", i*8+j); */
-	}
-    }
-    bin[max-1] = '\0';
-/*    printf("bin = %s \n", bin); */
-    for (i = 0; i < max-1; ++i)
-    {
-	if (bin[max-2-i] == '1')
-	{
-	    swapped = swapped + (int)pow( (double)2, (double)(i));
-	}
-    }
-    
-    return swapped;
-} /*END cswap2()*/
-
-/*==========================================================================*/
-/* cswap4: swap bits of a 4 byte number	    	    	    	    	    */
-/****************************************************************************/
-int cswap4(int decim)
-{
-    int i, j, max = 33;
-    char bin[33];
-    int swapped = 0;
-    
-    for (i = 3; i >= 0; --i)
-    {
-	for (j = 0; j < (max-1)/4; ++j)
-	{
-    	    if (decim & 0x80000000) bin[i*8+j] = '1';
-	    else bin[i*8+j] = '0';
-	    
-	    decim <<= 1;
-/*	    printf(" i*8+j = %d \n", i*8+j); */
-	}
-    }
-    bin[max-1] = '\0';
-/*    printf("bin = %s \n", bin); */
-    for (i = 0; i < max-1; ++i)
-    {
-	if (bin[max-2-i] == '1')
-	    swapped = swapped + (int)pow( (double)2, (double)(i));
-    }
-    
-    return swapped;
-} /*END cswap()*/
-
-/*==========================================================================*/
-/* decode_mspec_name: decode multiple spectrum filename     	    	    */
-/****************************************************************************/
-void decode_mspec_name(char name[], int *set, int *mxsp, int *numch,
-	int *sz, int bytes)
-{
-    float   pars[4];
-    int i, j;
-    char ans[80] = "", ans0[10];
-    
-    i = (strrchr(name,'_') - 1) - (strchr(name,'_') + 2);
-    memset(ans,'\0',sizeof(ans));
-    strncpy(ans,strchr(name,'_')+2, i);
-
-    /*read string BACKWARDS since at start is an optional
-     	multiple spectra set indicator*/
-
-    i--; j = 0;
-    /*read letter(s) at end*/
-    memset(ans0,'\0',sizeof(ans0));
-    while ( isalpha(ans[i]) ) ans0[j++] = ans[i--];
-    reverse(ans0);
-    if (!strncmp(ans0, "UI", j) || !strncmp(ans0, "ui", j))
-	*sz = (int)sizeof(unsigned int);
-    else if (!strncmp(ans0, "I", j) || !strncmp(ans0, "i", j))
-	*sz = (int)sizeof(unsigned int);
-    else if (!strncmp(ans0, "S", j) || !strncmp(ans0, "s", j))
-	*sz = (int)sizeof(short int);
-    else if (!strncmp(ans0, "US", j) || !strncmp(ans0, "us", j))
-	*sz = (int)sizeof(short int);
-    else if (!strncmp(ans0, "F", j) || !strncmp(ans0, "f", j))
-    	*sz = (int)sizeof(float);
-
-    /*read number of channels*/
-    while (! isdigit(ans[i]) ) i--;
-    j = 0;
-    memset(ans0,'\0',sizeof(ans0));
-    while ( isdigit(ans[i]) ) ans0[j++] = ans[i--];
-    reverse(ans0);
-    *numch = atoi(ans0);
-    
-    /*read number of spectra*/
-    while (! isdigit(ans[i]) ) i--;
-    j = 0;
-    memset(ans0,'\0',sizeof(ans0));
-    while ( isdigit(ans[i]) ) ans0[j++] = ans[i--];
-    reverse(ans0);
-    *mxsp = atoi(ans0);
-    
-    /*check for optional multiple spectra set indicator*/
-    if (i > 0)
-    {
-	while (! isdigit(ans[i]) ) i--;
-    	j = 0;
-    	memset(ans0,'\0',sizeof(ans0));
-    	while ( isdigit(ans[i]) ) ans0[j++] = ans[i--];
-    	reverse(ans0);
-    	*set = atoi(ans0);
-    }
-    
-    if ((*set)*(*sz)*(*mxsp)*(*numch) != bytes)
-    {
-	printf("Enter spectra details: set(s) of spectra, no. of spectra,"
-		" channels, bytes/chan.\n   (set, mxsp, numch, sz)\n");
-    	get_pars(pars,4);
-	*set = (int)pars[0];
-	*mxsp = (int)pars[1];
-    	*numch = (int)pars[2];
-	*sz = (int)pars[3];
-	if ((*set)*(*sz)*(*mxsp)*(*numch) != bytes)
-	{
-	    *numch = 0;
-	    return ;
-	}
-    }
-    
-    if ((*set)*(*sz)*(*mxsp)*(*numch) == bytes)
-	printf("Found %d sets of %d spectra: %d channels"
-	    " (%d bytes/channel)\n",*set,*mxsp,*numch,*sz);
-    
-    *mxsp *= *set;
-    return ;
-} /*END decode_mspec_name()*/
-
-/*==========================================================================*/
-/* file_status: check file status. 0 (file exists), -1 (file doesn't exist) */
-/****************************************************************************/
-void file_status(char name[], char ext[], int len)
-{
-    char    ans[3];
-    struct  stat statbuf;
-    
-    while ( (stat(name, &statbuf) == 0) )
-    {
-    	printf("\n*****Output file %s exists. Overwrite (y/n)?\n", name);
-	get_ans(ans,1);
-	if (ans[0] == 'y' || ans[0] == 'Y') break;
-	else if (ans[0] == 'n' || ans[0] == 'N')
-	{
-	    printf("Enter new file name inc. extension (eg %s):\n",ext);
-	    get_line(name, CHLEN);
-    	}
-    }
-} /*END file_status()*/
-
-/*==========================================================================*/
-/* genie_read: read an GENIE IEC format spectrum	    	    	    	    */
-/****************************************************************************/
-int genie_read(char name[])
-{
-    int     chan = 0, res = 0, lchan = CHMAX;
-    char    jk[10] = "";
-    FILE    *fsp;
-     
-    /*opens ascii file*/
-    if ((fsp = fopen(name, "r" )) == NULL)
-    {
-    	printf("Cannot open file: %s \n", name);
-    	return -1;	    	    	    
-    }
-    
-    /*skip the first 58 header lines*/
-    skip_lines(fsp, 58);
-    
-    for (chan = 0; chan < CHMAX; chan++)
-    { 
-        /*throw away first (ID?) string, e.g. A004 and read channel number*/     
-        res = fscanf(fsp, "%s %d",jk,&chan);
-        res = fscanf(fsp, "%f %f %f %f %f\n",
-            &spectrum[chan],&spectrum[chan+1],&spectrum[chan+2],
-            &spectrum[chan+3],&spectrum[chan+4]);
-	switch (res)
-	{
-	    case 0:
-	    {
-	    	printf("\nchan= %d, spec[chan]= %f\n", chan,
-		    	spectrum[chan]);
-    	    	printf("Read error occurred for file: %s\n", name);
-                /*close genie file*/
-	    	fclose(fsp);
-	    	return -1;
-	    }
-	    case EOF:
-	    {
-	    	if (chan < CHMAX)
-		{
-                    /*take one from chan that for(chan..) loop added*/
-                    chan--;
-	    	    printf("Reached EOF after reading chan %d \n", chan );
-		    if (chan == 0)
-		    {
-			printf("\n*******Incorrect file format*******\n");
-			printf("....Exiting....\n\n");
-			return -1;
-		    }
-		}
-		lchan = chan;
-                /*now set chan = CHMAX to exit for() loop*/
-	    	chan = CHMAX;
-    	    	break;
-	    }
-	    default:
-	    {
-/*	    	if (chan == 0) printf("Reading genie spectrum.......\n");
-                if (chan < 20)
-                {
-                  printf("%d %f %f %f %f %f\n",chan-4,
-                      spectrum[chan],spectrum[chan+1],spectrum[chan+2],
-                      spectrum[chan+3],spectrum[chan+4]);
-                }*/
-		/*increment chan. Normally starts from zero and
-                5 channels are read at a time but loop with also increment chan*/
-		chan += 4;
-	    	break;
-    	    }
-    	}
-    }
-    chan = lchan;
-    fclose(fsp); 
-    return (chan);
-} /*END genie_read()*/
-
-/*==========================================================================*/
-/* get_ans: get answer without waiting for carriage return   	    	    */
-/****************************************************************************/
-void get_ans(char ans[], int num)
-{
-    int     i;
-    struct  termios newt, oldt;
-    
-    while (1)
-    {
-    	tcgetattr(0, &oldt);
-	newt = oldt;
-    	newt.c_lflag &= ~ICANON;
-    	newt.c_cc[VMIN] = 1;
-    	newt.c_cc[VTIME] = 0;
-	/*handle sigs*/
-/*    	newt.c_lflag |= ISIG;*/
-    	tcsetattr(0, TCSANOW, &newt);
-    	i = 0;
-    	while( (ans[i++] = (char)getchar()) != '\n' && i < 1) ;
-    	
-	tcsetattr(0, TCSANOW, &oldt);
-    	if (ans[i-1] != '\n') printf("\n");
-	else if (ans[0] == '\n') continue;
-	
-    	ans[i] = '\0';
-    	return ;
-    }
-} /*END get_ans()*/
-
-/*==========================================================================*/
-/* get_line: read a line from stdin into s, return a length    	    	    */
-/****************************************************************************/
-void get_line(char ans[], int len)
-{
-    int     c, i = 0;
-
-    memset(ans,'\0',sizeof(char)*len);
-    /*note that scanf() leaves a carriage return in the keyboard buffer*/
-    while ( (c = getchar()) != '\n' && c != EOF && i < len) ans[i++] = c;
-    
-    ans[i] = '\0';
-} /*END get_line()*/
-
-/*==========================================================================*/
-/* get_line_file: read a line from a file into s, return a length           */
-/****************************************************************************/
-void get_line_file(FILE *file, char ans[], int len)
-{
-    int     c, i = 0;
-
-    memset(ans,'\0',sizeof(char)*len);
-    /*note that scanf() leaves a carriage return in the keyboard buffer*/
-    while ( (c = fgetc(file)) != '\n' && c != EOF && i < len) ans[i++] = c;
-    
-    /*remove any trailing '\r' carriage returns that are often prior to
-      '\n' line feeds*/
-    if (ans[i-1] == '\r') i--;
-    
-    ans[i] = '\0';
-} /*END get_line_file()*/
-
-/*==========================================================================*/
-/* get_mode: get mode from user input	    	    	    	    	    */
-/****************************************************************************/
-int get_mode(int md)
-{
-    char    ans[10] = "";
-    
-    while(1)
-    {
-    	printf(" 1) to convert %s (%s) ==> %s (%s)\n",fmti[0],exti[0],fmt[0],ext[0]);
-    	printf(" 2) to convert %s (%s) ==> %s (%s)\n",fmti[1],exti[1],fmt[1],ext[1]);
-    	printf(" 3) to convert %s (%s) ==> %s (%s)\n",fmti[2],exti[2],fmt[2],ext[2]);
-    	printf(" 4) to convert %s (%s) ==> %s (%s)\n",fmti[3],exti[3],fmt[3],ext[3]);
-    	printf(" 5) to convert %s (%s) ==> %s (%s)\n",fmti[4],exti[4],fmt[4],ext[4]);
-    	printf(" 6) to convert %s (%s) ==> %s (%s)\n",fmti[5],exti[5],fmt[5],ext[5]);
-    	printf(" 7) to convert %s (%s) ==> %s (%s)\n",fmti[6],exti[6],fmt[6],ext[6]);
-    	printf(" 8) to convert %s (%s) ==> %s (%s)\n",fmti[7],exti[7],fmt[7],ext[7]);
-    	printf(" 9) to convert %s (%s) ==> %s (%s)\n",fmti[8],exti[8],fmt[8],ext[8]);
-    	printf(" a) to convert %s (%s) ==> %s (%s)\n",fmti[9],exti[9],fmt[9],ext[9]);
-    	printf(" g) to gainmatch a RadWare spectrum\n");
-    	printf(" 0) Quit\n");
-	get_ans(ans,1);
- 	if (ans[0] - '0' >= 0 && ans[0] - '0' <= NUMOPT)
-	{
-	    md = ans[0] - '0';
-	    break;
-	}
-	else if (ans[0] == 'a' || ans[0] == 'A')
-	{
-	    md = 10;
-	    break;
-	}
-	else if (ans[0] == 'g' || ans[0] == 'G')
-	{
-	    md = NUMOPT;
-	    break;
-	}
-    }
-    return md;
-} /*END get_mode()*/
-
-/*==========================================================================*/
-/* get_pars: extract comma or space separated numbers from string ans0	    */
-/****************************************************************************/
-void get_pars(float pars[], int num)
-{
-    int     i, j = 0, k, minus;
-    char    ans0[CHLEN] = "", ans1[40] = "";
-
-    get_line (ans0, CHLEN);
-    
-    for (i = 0; i < num; i++)
-    {
-	k = 0;
-	minus = 0;
-    	memset(ans1,'\0',sizeof(ans1));
-	while ( ! isdigit(ans0[j]) )
-	{
-	    if (ans0[j] == '-') minus = 1;
-	    j++;
-	}
-	if (minus == 1)
-	{
-	    j -= 1;
-	    ans0[j] = '-';
-	}	
-	while( ans0[j] != '\n' && ans0[j] != ' ' && ans0[j] != ','
-		&& j < strlen(ans0) ) ans1[k++] = ans0[j++];
-	
-	j++;
-	pars[i] = atof(ans1);
-    }
-    printf("\n");
-} /*END get_pars()*/
-
-/*==========================================================================*/
-/* get_pars_file: extract separated numbers from string ans0 read from file */
-/****************************************************************************/
-void get_pars_file(FILE *file, float pars[], int num)
-{
-    int     i, j = 0, k, minus;
-    char    ans0[CHLEN] = "", ans1[40] = "";
-
-    get_line_file(file, ans0, CHLEN);
-    
-    for (i = 0; i < num; i++)
-    {
-	k = 0;
-	minus = 0;
-    	memset(ans1,'\0',sizeof(ans1));
-	while ( ! isdigit(ans0[j]) )
-	{
-	    if (ans0[j] == '-') minus = 1;
-	    j++;
-	}
-	if (minus == 1)
-	{
-	    j -= 1;
-	    ans0[j] = '-';
-	}	
-	while( ans0[j] != '\n' && ans0[j] != ' ' && ans0[j] != ','
-		&& j < strlen(ans0) ) ans1[k++] = ans0[j++];
-	
-	j++;
-	pars[i] = atof(ans1);
-    }
-} /*END get_pars_file()*/
-
-/*==========================================================================*/
-/* get_val: extract a number from string ans0	    	    	    	    */
-/****************************************************************************/
-void get_val(float *val)
-{
-    int     j = 0, k, minus;
-    char    ans0[CHLEN] = "", ans1[40] = "";
-
-    get_line(ans0, CHLEN);
-    
-    k = 0;
-    minus = 0;
-    memset(ans1,'\0',sizeof(ans1));
-    while ( ! isdigit(ans0[j]) )
-    {
-    	if (ans0[j] == '-') minus = 1;
-    	j++;
-    }
-    if (minus == 1)
-    {
-    	j -= 1;
-    	ans0[j] = '-';
-    }	    
-    while( ans0[j] != '\n' && ans0[j] != ' ' && ans0[j] != ','
-    	    && j < strlen(ans0) ) ans1[k++] = ans0[j++];
-
-    j++;
-    *val = atof(ans1);
-    printf("\n");
-} /*END get_val()*/
-
-/*===========================================================================*/
-/* itoa: convert integer n to string s*/
-/*****************************************************************************/
-void itoa(int n, char s[])
-{
-    int i = 0, sign;
-    
-    /*record sign and make n positive*/
-    if ((sign = n) < 0) n = -n;
-
-    /* generates digits in reverse order */
-    do {
-        /*get next digit*/
-    	s[i++] = n % 10 + '0';
-      /* delete it*/
-    } while ((n /= 10) > 0);
-    if (sign < 0) s[i++] = '-';
-    
-    s[i] = '\0';
-    reverse(s);
-} /*END itoa()*/
-
-/*===========================================================================*/
-/* maestro_read: read the maestro format spectrum                            */
-/*****************************************************************************/
-int maestro_read(char name[])
-{
-    int *counts, i = 0;
-    char dt[10] = "";
-    FILE *fsp;
-        
-    /*opens read only Maestro file*/
-    if ( (fsp = fopen(name, "r")) == NULL)
-    {
-    	printf("Cannot open file: %s\n", name);
-	return -1;
-    }    
-    /*clear the header*/
-    memset(&maest_header, 0, sizeof(maest_header));
-    /*construct Maestro header*/
-    fread(&maest_header, sizeof(maest_header), 1, fsp);
-        
-/*    printf(" maest_header.q1 = %d\n maest_header.q2 = %d \n"
-	   " maest_header.q3 = %d\n maest_header.q4 = %d \n"
-	   " maest_header.real = %d\n maest_header.lve = %d \n"
-	   " maest_header.dt = %s\n maest_header.sttm = %s \n"
-	   " maest_header.off = %d\n maest_header.channels = %d\n",
-	    maest_header.q1, maest_header.q2, maest_header.q3,
-	    maest_header.q4, maest_header.real, maest_header.lve,
-            maest_header.dt, maest_header.sttm, maest_header.off,
-            maest_header.channels);*/
-    
-    /*unix byte swapping option*/
-    if (maest_header.channels > CHMAX && cswap4(maest_header.channels) > CHMAX )
-    {
-    	printf("Unrecognised format. Exiting.....\n");
-	fclose(fsp);
-    	return -1;
-    }
-    if (maest_header.channels > CHMAX || 
-            maest_header.channels < (i = cswap2(CHMAX)) )
-    {
-	/*swap the bytes in the headers*/
-    	maest_header.channels = cswap2(maest_header.channels);
-	maest_header.real = cswap4(maest_header.real);
-	maest_header.lve = cswap4(maest_header.lve);
-        
-	printf(".......SWAPPING BYTES read from file.......\n");
-    	/*allocate sufficient memory for spectrum*/
-    	counts = (int *) malloc( maest_header.channels*sizeof(int) );
-    	/*read the data*/
-	fread(counts, maest_header.channels*sizeof(int), 1, fsp);
-	/*read the trailer*/
-	fread(&maest_trailer, sizeof(maest_trailer), 1, fsp);
-    	maest_trailer.g[0] = cswap4(maest_trailer.g[0]);
-    	maest_trailer.g[1] = cswap4(maest_trailer.g[1]);
-    	maest_trailer.g[2] = cswap4(maest_trailer.g[2]);
-
-      	/*fill spectrum array*/
-    	for (i = 0; i < (int) maest_header.channels; i++)
-	    swapb4( (char *) (counts + i) );	
-    } /*end of byte swapping loop for unix*/    
-    else
-    {
-    	/*allocate sufficient memory for spectrum*/
-    	counts = (int *) malloc( maest_header.channels*sizeof(int) );
-	/*read the data*/
-	fread(counts, maest_header.channels*sizeof(int), 1, fsp);
-	/*read the trailer*/
-	fread(&maest_trailer, sizeof(maest_trailer), 1, fsp);
-    }
-    /*fill spectrum array*/
-    for (i = 0; i < maest_header.channels; i++)
-        spectrum[i] = (float)*(counts + i);
-    
-    
-    /*print real and live times to screen and convert from 20ms units to sec*/
-    /*Copy day and month*/
-    strncpy(dt, maest_header.dt, 5);
-    /*check year, if maest_header.dt[7] == 1 year is 2000+YY else 1900+YY*/
-    if (maest_header.dt[7] == '1') strncpy(dt+5, "20", 2);
-    else strncpy(dt+5, "19", 2);
-    strncpy(dt+7, maest_header.dt+5, 2);
-    dt[9] = '\0';
-    printf("Spectrum info: %s at %c%c:%s\n"
-           "               Real time: %d s\n"
-           "               Live time: %d s\n",dt,maest_header.sttm[0],
-            maest_header.sttm[1],maest_header.sttm+2,
-            (int)(maest_header.real*0.02),(int)(maest_header.lve*0.02));
-    
-    /*print potentially useful trailer information*/
-    printf("Maestro energy calibration coeffs: %f %f %f\n",
-          maest_trailer.g[0],maest_trailer.g[1],maest_trailer.g[2]);
-    
-    free(counts);
-    fclose(fsp);
-    return maest_header.channels;
-} /*END maestro_read()*/
-
-/*==========================================================================*/
-/* num_fname: create numbered filenames	    	    	    	    	    */
-/****************************************************************************/
-void num_fname(char name[], int num)
-{
-    int i = 0, j, len;
-    char ans[MXNUMDIG+1] = "", buf[MXNUMDIG+3] = "";
-    
-    len = strlen(name);
-    strncpy(buf+i++, "_", 1);
-    itoa(num, ans);
-    
-    /*add zeroes to pad out file name if num is less than the maximum
-        number of digits*/
-    for (j = 0; j < (MXNUMDIG - (int)strlen(ans)); j++)
-        strncpy(buf+i++, "0", 1);
-    
-    strncpy(buf+i, ans, (int)strlen(ans));
-    i += (int)strlen(ans);
-    strncpy(buf+i++, ".", 1);
-    buf[i] = '\0';
-    if ( (strrchr(name,'.')) )
-	strncpy( (strrchr(name,'.')), buf, i);
-    else strncat(name, buf, i);
-    
-    /*length without ext.*/
-    i = strrchr(name,'.') - &name[0];
-    for (j = 1; j < (len - i); j++) name[i+j] = (char)0;
-    
-    return;
-} /*END num_fname()*/
-
-/*===========================================================================*/
-/* rad_read: read the radware format spectrum */
-/*****************************************************************************/
-int rad_read(char name[])
-{
-    float *counts;
-    int i = 0;
-    FILE *fsp;
-        
-    /*opens read only RadWare file*/
-    if ( (fsp = fopen(name, "r")) == NULL)
-    {
-    	printf("Cannot open file: %s\n", name);
-	return -1;
-    }
-    
-    /*clear the header*/
-    memset(&radheader, 0, sizeof(radheader));
-    /*construct radware header*/
-    fread(&radheader, sizeof(radheader), 1, fsp);
-        
-/*    printf(" radheader.channels = %d\n radheader.q1 = %d \n"
-	   " radheader.q3 = %d\n radheader.q4 = %d \n"
-	   " radheader.q5 = %d\n radheader.size = %d \n",
-	    radheader.channels, radheader.q1, radheader.q3,
-	    radheader.q4, radheader.q5, radheader.size);*/
-       
-    /*unix byte swapping option*/
-    if (radheader.channels > CHMAX && cswap4(radheader.channels) > CHMAX )
-    {
-    	printf("Unrecognised format. Exiting.....\n");
-	fclose(fsp);
-    	return -1;
-    }
-    if (radheader.channels > CHMAX)
-    {
-	/*swap the bytes in the headers*/
-    	radheader.channels = cswap4(radheader.channels);
-	radheader.q1 = cswap4(radheader.q1);
-	radheader.q2 = cswap4(radheader.q2);
-    	radheader.q3 = cswap4(radheader.q3);
-    	radheader.q4 = cswap4(radheader.q4);
-    	radheader.q5 = cswap4(radheader.q5);
-	radheader.size = cswap4(radheader.size);
-		
-	printf(".......SWAPPING BYTES read from file.......\n");
-    	/*allocate sufficient memory for spectrum*/
-    	counts = (float *) malloc( radheader.channels*sizeof(float) );
-	
-    	/*read the data*/
-	fread(counts, radheader.size, 1, fsp);
-	/*read the trailer*/
-	fread(&radtrailer.size, 4, 1, fsp);
-	radtrailer.size = cswap4(radtrailer.size);
-    	
-    	/*fill spectrum array*/
-    	for (i = 0; i < (int) radheader.channels; i++)
-	    swapb4( (char *) (counts + i) );	
-    }
-    /*end of byte swapping loop for unix*/    
-    else
-    {
-    	/*allocate sufficient memory for spectrum*/
-    	counts = (float *) malloc( radheader.channels*sizeof(float) );
-	/*read the data*/
-	fread(counts, radheader.size, 1, fsp);
-	/*read the trailer*/
-	fread(&radtrailer.size, 4, 1, fsp);    
-    }
-    /*fill spectrum array*/
-    for (i = 0; i < radheader.channels; i++)
-    	spectrum[i] = (float)*(counts + i);
-    
-    free(counts);
-    fclose(fsp);
-    return radheader.channels;
-} /*END rad_read()*/
-
-/*==========================================================================*/
-/* rad_write: prepare and write the radware format spectrum      	    */
-/****************************************************************************/
-void rad_write(char name[], int numch)
-{
-    int     j;
-    FILE    *fsp;
-        
-    /*open .spe write only file*/
-    if ( (fsp = fopen(name, "w" )) == NULL)
-    {
-    	printf("Cannot open file: %s \n", name);
-	return ; 
-    } 	    	    
-    	  
-    /*clear the header*/
-    memset(&radheader, 0, sizeof(radheader));
-    /*clear the trailer*/
-    memset(&radtrailer, 0, sizeof(radtrailer));
-    
-    /*construct radware header*/
-    radheader.q1 = 24;
-    
-    /*length without ext.*/
-    j = strrchr(name,'.') - &name[0];
-    /*copy max. 8 bytes to radheader.name*/
-    strncpy(radheader.name, name, 8);
-    /*set any extra characters so spaces*/
-    if (j < 8) memset(&radheader.name[j], ' ', 8-j);
-    
-    radheader.channels = numch;
-    radheader.q2 = 1;
-    radheader.q3 = 1;
-    radheader.q4 = 1;
-    radheader.q5 = 24;
-    radheader.size = numch * sizeof(float);
-    
-    radtrailer.size = numch * sizeof(float);
-  
-    fwrite(&radheader, sizeof(radheader), 1, fsp);
-    fwrite(spectrum, radheader.size, 1, fsp);
-    fwrite(&radtrailer, sizeof(float), 1, fsp);
-
-    printf(" ==> %s %d chs.\n", name, numch);
-    
-    fclose(fsp);
-} /*END rad_write()*/
-
-/*==========================================================================*/
-/* read_lst: read next spectrum name from list file   	    	    	    */
-/****************************************************************************/
-int read_lst(char inname[], int lst)
-{
-    static int  fn = 0;
-    int         res;
-    char        listname[CHLEN] = "";
-    static FILE *flst;
-    
-    /*open list file to read spec names*/
-    if (fn == 0 && lst == 1)
-    {
-        if (md == NUMOPT)
-    	    printf("Type filename containing list of spectrum file names"
-		    " and coefficients: \n");
-	else printf("Type filename containing list of spectrum file names:\n");
-	
-	get_line(listname, CHLEN);	
-    }
-    /*open file on first time in function*/
-    if (fn == 0)
-    {
-        if (lst == -1) strcpy(listname,inname);
-    	if ((flst = fopen(listname, "r" )) == NULL)
-    	{
-    	    printf("Cannot open file: %s \n", listname);
-    	    return -1;			
-    	}
-    }
-    
-    /*read and store ascii file names*/
-    /*skip comments lines starting with #*/
-    skip_hash(flst);
-    if (md == NUMOPT) res = fscanf(flst, "%s %f %f %f", inname,
-    		&gain[0], &gain[1], &gain[2]);
-    else res = fscanf(flst, "%s", inname);
-    
-    switch (res)
-    {
-    	case 0:
-    	{
-    	    printf("Read error occurred for file: %s\n", listname);
-    	    fclose(flst);
-    	    return -1;
-    	}
-    	case EOF:
-    	{
-    	    printf("\n\tRead %d spectrum names\n\n", fn);
-    	    fclose(flst);	    
-    	    return -1;
-    	}
-    	default:
-    	{
-    	    fn++;
-    	    printf("Read filename %d from list: %s\n",fn, inname);
-	    return fn;
-    	}
-    }
-} /*END read_lst()*/
-
-/*==========================================================================*/
-/* read_spec: call appropriate spectrum_read function based on mode    	    */
-/****************************************************************************/
-int read_spec(char name[], int md)
-{
-    int i = 0;
-    
-    if (md == 1) i = rad_read(name);
-    else if (md == 2) i = ascii_read(name);
-    else if (md == 3) i = ascii_read(name);
-    else if (md == 4) i = maestro_read(name);
-    else if (md == 5) i = maestro_read(name);
-    else if (md == 8) i = genie_read(name);
-    else if (md == 9) i = ascii_read(name);
-    else if (md == 10) i = ascii_read(name);
-    else if (md == NUMOPT) i = rad_read(name);
-    else return -1;
-    
-    return i;
-} /*END read_spec()*/
-
-/*==========================================================================*/
-/* reverse: reverse string s in place	    	    	    	    	    */
-/****************************************************************************/
-void reverse(char s[])
-{
-    int c, i, j;
-
-    for (i = 0, j = strlen(s)-1; i < j; i++, j--)
-    {
-        c = s[i];
-        s[i] = s[j];
-        s[j] = c;
-    }
-} /*END reverse()*/
-
-/*==========================================================================*/
-/* set_ext: set file extension of string name[] to ext[]   	    	    */
-/****************************************************************************/
-void set_ext(char name[], char ext[])
-{    
-    /*if not equal to NULL, find '.' then copy ext with +1 for term char*/
-    if ( (strrchr(name,'.')) )
-        strncpy( (strrchr(name,'.')), ext, (int)(strlen(ext)+1) );
-    /*if equal to NULL just add ext to the end*/
-    else strcat( name, ext );
-} /*END set_ext()*/
-
-/*==========================================================================*/
-/* skip_hash: skip comment lines starting with hash (#) at start of file    */
-/****************************************************************************/
-void skip_hash(FILE *file)
-{
-    int     i = 0, hash = 0;
-    fpos_t  pos;
-    
-    for (i = 0; i < 1000; i++)
-    {
-    	/*store position corresponding to start of line*/
-    	fgetpos(file, &pos);
-        /*check for carriage return in the keyboard buffer
-            due to scanf function*/
-        if ( (hash = fgetc(file)) == '\n' ) fgetpos(file, &pos);
-    	else fsetpos(file, &pos);
-    	if ( (hash = fgetc(file)) != '#' )
-    	{
-    	    /*reset position to start of line*/
-    	    fsetpos(file, &pos);
-    	    break;
-    	}
-    	/*read rest of line*/
-    	while ( ( (hash = fgetc(file)) != '\n' ) && (hash != EOF) )
-            ;
-    }
-} /*END skip_hash()*/
-
-/*==========================================================================*/
-/*skip_lines: skip lns lines in file                                        */
-/****************************************************************************/
-void skip_lines(FILE *file, int lns)
-{
-    int cnt = 0, hash = 0;
-    
-    while (cnt < lns)
-    {
-        while ( ( (hash = fgetc(file)) != '\n' ) && (hash != EOF) )
-           ;
-        
-        if (hash == EOF)
-        {
-            printf("Found EOF...returning\n");
-            return ;
-        }
-        /*increment counter on each carriage return*/
-        cnt++;
-    }
-} /*END skip_lines()*/
-
-/*==========================================================================*/
-/* store_colours: store colours in clr[][] array                            */
-/****************************************************************************/
-void store_colours()
-{
-    /*none*/
-    strcpy(clr[0], "\033[0;0m");
-    /*white on red background*/
-    strcpy(clr[1], "\033[0;41m");
-    /*green no background*/
-    strcpy(clr[2], "\033[0;32m");
-    /*white on blue background*/
-    strcpy(clr[3], "\033[0;44m");
-    /*bold*/
-    strcpy(clr[4], "\033[1m");
-    /*underline*/
-    strcpy(clr[5], "\033[0;4m");
-} /*END store_colours()*/  
-
-/*==========================================================================*/
-/* swapb2: swap 2 array elements (a 2 byte number) in place 	    	    */
-/****************************************************************************/
-void swapb2(char *buf)
-{
-    char c;
-    c = buf[1]; buf[1] = buf[0]; buf[0] = c;
-} /*END swapb2()*/
-
-/*==========================================================================*/
-/* swapb4: swap 4 array elements (a 4 byte number) in place 	    	    */
-/****************************************************************************/
-void swapb4(char *buf)
-{
-    char c;
-    c = buf[3]; buf[3] = buf[0]; buf[0] = c;
-    c = buf[2]; buf[2] = buf[1]; buf[1] = c;    
-} /*END swapb4()*/
-
-/*==========================================================================*/
-/* write_spec: call appropriate spectrum_write function based on mode       */
-/****************************************************************************/
-void write_spec(char name[], int numch, int md)
-{
-    if (md == 1) ascii_write(name, numch);
-    else if (md == 2) rad_write(name, numch);
-    else if (md == 3) xtrack_write(name, numch);
-    else if (md == 4) ascii_write(name, numch);
-    else if (md == 5) rad_write(name, numch);
-    else if (md == 6) ascii_write(name, numch);
-    else if (md == 7) rad_write(name, numch);
-    else if (md == 8) rad_write(name, numch);
-    else if (md == 9) rad_write(name, numch);
-    else if (md == 10) ascii_write(name, numch);
-    else if (md == NUMOPT) rad_write(name, numch);
-
-    return ;
-} /*END write_spec()*/
-
-/*==========================================================================*/
-/* xtrack_read: read an xtrack (GASPWARE) format spectrum   	    	    */
-/****************************************************************************/
-void xtrack_read(char name[], int *numch, int mxsp, int sz, int nsp, int flg)
-{
-    int i = 0, last_nonzero_channel = 0, mxcnts = 0;
-    unsigned int *xtrack_spec;
-    FILE *fp;
-         
-    /*open xtrack file*/
-    if ((fp = fopen(name, "r" )) == NULL)
-    {
-    	printf("Cannot open file: %s \n", name);
-    	*numch = -1;
-	return ;	    	    	    
-    }
-    
-    if (mxsp > 1 && nsp > 0) fseek(fp, (int)(nsp*(*numch)*sz), 0);
-    
-    xtrack_spec = (unsigned int *) malloc(*numch*sz);
-    
-    while ( fread(xtrack_spec, *numch*sz, 1, fp) != 1 )
-    {
-    	*numch /= 2;	    
-	printf("Trying spectrum length: %d channels\n", *numch);
-	if (*numch <= 1024)
-	{
-    	    printf("Error reading file: %s \n", name);
-	    *numch = -1;
-	    return ;
-	}
-    }
-    printf(" Length = %d channels was successful\n", *numch);
-	        
-    for (i = 0; i < *numch; i++)
-    {
-	/*Note that in the conversion int is necessary first to get the
-	    	sign correct*/
-	spectrum[i] = (float) (int) *(xtrack_spec + i);
-/*	printf("i = %d spectrum[i] = %f\n", i, spectrum[i]); */
-	
-	if (spectrum[i] != 0) last_nonzero_channel = i;
-	
-	if (spectrum[i] > mxcnts) mxcnts = (int) spectrum[i];
-	
-    }
-    
-    if (mxcnts > 10000000)    /*Probably not an Xtrack format spectrum*/
-    {
-	printf("***WRONG FORMAT. NOT AN XTRACK SPECTRUM***\n");
-	*numch = -1;
-	return ;
-    }
-    
-    /*only remove zeroes if not multiple spectrum file or list*/
-    if (flg != 1)
-    {
-    	while (last_nonzero_channel < (*numch/2) && *numch >= 1024) *numch /= 2;
-    	printf("Real length of spectrum (after removing zeros) = %d channels\n",
-	    *numch);
-    }
-/*    else printf("Length of spectrum = %d channels\n",*numch);*/
-       
-    fclose(fp);
-    return ; 
-    
-} /*END xtrack_read()*/
-
-/*==========================================================================*/
-/* xtrack_write: write a (GASPWARE) format spectrum    	    	    	    */
-/****************************************************************************/
-void xtrack_write(char name[], int numch)
-{
-    int i = 0;
-    unsigned int tmp_spec[CHMAX];
-    unsigned int numbytes;
-    FILE *fsp;
-         
-    /*open .spec write only file*/
-    if ( (fsp = fopen(name, "w" )) == NULL)
-    {
-    	printf("Cannot open file: %s \n", name);
-	return ; 
-    } 	    	    
-
-    numbytes = numch*sizeof(unsigned int);
-        
-    for (i = 0; i < numch; i++) tmp_spec[i] = (unsigned int)spectrum[i];
-    
-    fwrite(&tmp_spec, numbytes, 1, fsp);
-
-    printf(" ==> %s %d chs.\n", name, numch);
-    
-    fclose(fsp);
-} /*END xtrack_write()*/
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <ctype.h>
+#include <math.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <termios.h>
+#include <pthread.h>
+#include <sys/wait.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <signal.h>
+#include <dirent.h>
+#include <glob.h>
+
+#define CHMAX 	  32768	/*max number of channels in spectra*/
+#define MAXCOLS   3     /*max. number data columns in input spectrum*/
+#define MXNUMDIG  3     /*max number of digits for the number of multi spectra
+                            that can be extracted. i.e. 3 ==> 999 spectra*/
+#define NUMOPT    17    /*number of options*/
+#define NUMOFMT   10    /*number of selectable output formats*/
+#define CHLEN     120   /*character length of filename arrays*/
+#define MXTHR     16    /*max. number of worker threads*/
+#define LMBLK     65536 /*list-mode records read per pread() block*/
+#define NPREF     8     /*list entries prefetched ahead of conversion*/
+#define PFMAX     67108864 /*max. bytes of a prefetched input file*/
+#define NOBUF     4     /*output buffers queued for the writer thread*/
+#define OBUFSZ    4194304 /*bytes per output buffer*/
+#define MODECH    "0123456789alpuknrg" /*menu characters, index = mode*/
+#define REQMAX    16384 /*max. bytes of a server request (excl. payload)*/
+#define NTMPO     4     /*output files open at once as name.tmp*/
+#define JNLOUT    1024  /*bytes of output names journaled per entry*/
+#define NWFLT     8     /*max. number of -I input filters*/
+#define NWTHR     4     /*threads searching directories*/
+#define NCLAIM    65536 /*output names claimed per run of option u*/
+#define WALKLST   "spec_conv.lst" /*list name of directory/pattern inputs*/
+#define SHMNAME   "/spec_conv" /*POSIX shared memory segment for publishing*/
+#define NSHMSL    256   /*spectrum slots in the shared memory segment*/
+#define MXROI     100   /*max. number of ROIs per spectrum*/
+#define NSTW      8     /*max. number of statistics windows*/
+#define NSPESEC   32    /*max. number of $SECTIONs of a Maestro .Spe*/
+#define SPOCC     8     /*sparse if fewer than 1/SPOCC channels are nonzero*/
+#define BGMAX     200   /*max. number of SNIP background iterations*/
+#define NARF      8     /*max. number of spectrum files in an expression*/
+#define EXPLEN    512   /*max. length of an arithmetic expression*/
+#define MXPYR     20    /*max. number of levels of a preview pyramid*/
+#define LMPRIV    268435456 /*max. bytes of per-thread private histograms,
+                            above this shared atomic histograms are used*/
+                            
+/* Carl Wheldon May 2003 */
+/* Lastest up-date May 2025*/
+
+/* To compile:
+gcc spec_conv.c -Wall -pedantic -o spec_conv -lm -lpthread -lrt -O2
+*/
+
+/*%%%%% A program to convert between different spectra formats %%%%%*/
+/* To add a new option:
+    add input extension and format to exti[] and fmti[],
+    add output extension and format to ext[] and fmt[],
+    edit get_mode() and MODECH, read_spec() and write_spec(),
+    and add md (i.e. mode number) to relevant point in run_conv().*/
+
+/*structure of the radware header as written to/read from a spectrum*/
+struct radheader {
+    unsigned int q1;
+    char    	 name[8];
+    unsigned int channels;
+    unsigned int q2;
+    unsigned int q3;
+    unsigned int q4;
+    unsigned int q5;
+    unsigned int size;
+} radheader;
+
+/*structure of the radware trailer*/
+struct radtrailer {
+    unsigned int size;
+} radtrailer;
+
+/*structure of the Ortec Maestro header as written to/read from a spectrum*/
+struct  maest_header {
+    short int q1;           /*must be one*/
+    short int q2;           /*MCA/det number*/
+    short int q3;           /*segment number*/
+    short int q4;           /*ascii second of start time*/
+    unsigned int real;      /*real time (increments of 20 ms)*/
+    unsigned int lve;       /*live time (increments of 20 ms)*/
+    char dt[8];             /*Start date as ASCII DDMMMYY*
+                              The * character should be ignored if it is not
+                              a "1". If it is a "1", it indicates the data is
+                              after the year 2000.*/
+    char sttm[4];           /*start time as ASCII HHMM or binary zeros,
+                                if not known*/
+    short int off;          /*channel offset of data*/
+    short int channels;     /*length of data (channels)*/
+} maest_header;
+
+/*structure of the Ortec Maestro header as written to/read from a spectrum*/
+struct  maest_trailer {
+    short int t1;           /*must be -102 (102, -101 in older files)*/
+    short int t2;           /*reserved???*/
+    float     g[3];         /*energy calib coeff offset, gain and quadratic term*/  
+    char      trailer[496]; /*nothing particularly useful in the rest of the trailer*/
+} maest_trailer;
+
+/*structure describing the fixed-width records of a list-mode event file*/
+struct lmlayout {
+    int     reclen;         /*record length in bytes*/
+    int     detoff;         /*byte offset of detector ID in record*/
+    int     detsz;          /*size of detector ID in bytes (1, 2 or 4)*/
+    int     enoff;          /*byte offset of energy in record*/
+    int     ensz;           /*size of energy in bytes (1, 2, 4 or -4 = float)*/
+    int     ndet;           /*number of detectors (spectra)*/
+    int     numch;          /*channels per spectrum*/
+    int     comp;           /*energy compression factor*/
+    int     swap;           /*1 if data are big-endian*/
+    long    hdr;            /*bytes of file header to skip*/
+} lmlayout;
+
+/*nonzero channels of spectrum[], see sp_pack()*/
+struct sparse {
+    int     n;              /*number of nonzero channels*/
+    int     numch;          /*channels in the spectrum*/
+    int     ch[CHMAX];      /*nonzero channels in increasing order*/
+    float   cnt[CHMAX];     /*their counts*/
+} sparse;
+
+/*ROI areas of one spectrum, in memory shared with the worker processes*/
+struct roires {
+    int     nroi;           /*number of ROIs, -1 if the spectrum was not read*/
+    int     lo[MXROI], hi[MXROI];
+    double  gross[MXROI];   /*counts in lo..hi*/
+    double  bg[MXROI];      /*linear background under the ROI*/
+    double  err[MXROI];     /*uncertainty of gross - bg*/
+};
+
+/*value of an arithmetic expression: a spectrum with its variances, or a
+    constant k when y is NULL*/
+struct arval {
+    float   k;
+    float   *y;
+    float   *v;
+};
+
+/*spectrum files of an arithmetic expression, read once per run*/
+struct arcache {
+    int     n;
+    char    name[NARF][CHLEN];
+    int     numch[NARF];
+    float   live[NARF];
+    float   real[NARF];
+    float   *y[NARF];
+} arcache;
+
+/*layout of a multiple spectrum file as recorded in its index "<file>.idx"*/
+struct layidx {
+    int     set;            /*sets of spectra*/
+    int     mxsp;           /*spectra per set*/
+    int     numch;          /*channels per spectrum*/
+    int     sz;             /*bytes per channel*/
+    char    type[3];        /*element type as in the file name, e.g. UI*/
+    char    endian;         /*L or B*/
+    int     fresh;          /*1 if the ranges below are for the file as it is*/
+    int     *first, *last;  /*first/last nonzero channel, -1 if empty*/
+    double  *tot;           /*total counts*/
+} layidx;
+
+/*spectrum metadata found in file headers and trailers*/
+struct specmeta {
+    char    fmt[14];        /*format name, e.g. Maestro_Chn*/
+    float   live;           /*live time (s), < 0 if not known*/
+    float   real;           /*real time (s), < 0 if not known*/
+    char    date[12];       /*start date as DDMMMYYYY or MM/DD/YYYY*/
+    char    time[10];       /*start time as HH:MM:SS*/
+    int     channels;       /*number of channels*/
+    int     off;            /*channel offset of data*/
+    float   cal[3];         /*energy calib coeff offset, gain and quadratic*/
+    char    name[9];        /*spectrum name (RadWare)*/
+    int     err;            /*non-zero if the header could not be decoded*/
+    float   fit[2];         /*energy fit offset and gain (Maestro .Spe)*/
+    int     nroi;           /*number of ROIs (Maestro .Spe)*/
+    int     roi[MXROI][2];  /*first and last channel of each ROI*/
+    int     sp;             /*spectrum number in a multiple spectrum file*/
+    int     nsp;            /*number of spectra in the file (Xtrack)*/
+    int     sz;             /*bytes per channel (Xtrack)*/
+    char    src[CHLEN];     /*file the spectrum was read from*/
+};
+/*metadata of the spectrum last read, carried to the writers*/
+struct specmeta meta = {"", -1.0, -1.0};
+
+/*work shared by header probing threads*/
+struct probejob {
+    char    **names;        /*spectrum filenames*/
+    struct  specmeta *meta; /*one metadata record per file*/
+    int     n;              /*number of files*/
+    int     next;           /*next file to probe (atomic counter)*/
+};
+
+/*a prefetched input file*/
+struct pfslot {
+    char    name[CHLEN];
+    char    *buf;           /*file contents (buffer reused for later files)*/
+    long    len, cap;       /*bytes read and bytes allocated*/
+    int     state;          /*0 loading, 1 ready, 2 not prefetched*/
+};
+
+/*read/convert/write pipeline: a prefetch thread reads list entries ahead
+    into slots, the conversion thread reads them from memory and its output
+    goes to buffers written to disk by a writer thread*/
+struct pipeline {
+    int     run;            /*1 while the pipeline is active*/
+    char    **names;        /*list entries w, w+nw, w+2nw... are converted*/
+    int     n, nw, next;    /*number of entries, stride, next to prefetch*/
+    int     own;            /*1 if names[] is freed by pipe_stop()*/
+    struct  pfslot slot[NPREF];
+    int     head, cnt;      /*oldest slot and number of slots in use*/
+    int     cur;            /*slot being converted (always head) or -1*/
+    char    *obuf[NOBUF];   /*output buffers*/
+    FILE    *ofp[NOBUF];    /*open output stream on each buffer or NULL*/
+    char    oname[NOBUF][CHLEN];
+    char    oent[NOBUF][CHLEN]; /*list entry each output is written for*/
+    char    omode[NOBUF];   /*'w' to replace the file, 'a' to append*/
+    long    olen[NOBUF];    /*bytes to write, -1 if buffer free*/
+    int     oq[NOBUF];      /*queue of buffers waiting to be written*/
+    int     ocnt;
+    int     wfail;          /*outputs the writer failed to write*/
+    pthread_mutex_t mx;
+    pthread_cond_t cv;
+    pthread_t rt, wt;
+} pipeline;
+
+/*output files written as name.tmp and renamed to name when closed, so
+    that a crash never leaves a partly written output*/
+struct tmpout {
+    FILE    *fp[NTMPO];
+    char    name[NTMPO][CHLEN+8];
+} tmpout;
+
+/*hashes of the output names written by a run of option u, shared with the
+    worker processes so two inputs never write one output*/
+unsigned long long *oclaim = NULL;
+
+/*journal of the list entries converted, to resume an interrupted run*/
+struct journal {
+    int     on;             /*1 while the entries are journaled*/
+    char    name[CHLEN+4];  /*list.jnl*/
+    char    **done;         /*entries converted by the earlier run (sorted)*/
+    int     n;
+    char    cur[CHLEN];     /*entry being converted*/
+    char    outs[JNLOUT];   /*its outputs, tab separated*/
+    int     nf;             /*failures when it was started*/
+} journal;
+
+/*directory and pattern inputs: walker threads search them and queue the
+    files found as CHLEN byte records on a pipe, read by the conversion
+    loop (or the worker processes) as they arrive*/
+struct walker {
+    int     on;             /*1 if the inputs are searched*/
+    char    **item;         /*stack of inputs still to search*/
+    char    *type;          /*'d' directory, 'g' pattern, 'f' file*/
+    int     n, mx;
+    int     busy;           /*threads searching an item*/
+    int     left;           /*threads running, the last closes the queue*/
+    int     stop;           /*set when the queue is no longer read*/
+    int     nthr, md, pid;
+    int     fd[2];          /*the queue, fd[1] is -1 once closed*/
+    char    flt[NWFLT][16]; /*extensions (.xxx) or formats to take*/
+    int     nflt;
+    char    desc[4*CHLEN];  /*the inputs, to recognise a journal*/
+    pthread_mutex_t lock;
+    pthread_cond_t cv;
+    pthread_t tid[NWTHR];
+} walker;
+
+/*directory at the start of the shared memory segment, followed by the slots*/
+struct shmdir {
+    char    magic[8];       /*"SPECSHM" once initialised*/
+    int     nslot;          /*number of slots (NSHMSL)*/
+    int     chmax;          /*channels per slot (CHMAX)*/
+    int     slotsz;         /*bytes per slot*/
+    unsigned int gen;       /*incremented on every publish*/
+};
+
+/*one published spectrum: readers copy it while seq is even and unchanged*/
+struct shmslot {
+    unsigned int seq;       /*odd while the slot is being written*/
+    unsigned int state;     /*0 free, 1 being claimed, 2 in use*/
+    char    name[CHLEN];    /*output name the spectrum is published under*/
+    struct  radheader hdr;  /*as written by rad_write()*/
+    float   data[CHMAX];
+};
+
+/*arguments of a list-mode histogramming thread*/
+struct lmthread {
+    int     fd;             /*file descriptor of list-mode file*/
+    long    r0, r1;         /*first and last+1 record to histogram*/
+    unsigned int *hist;     /*private (or shared) histograms [ndet][numch]*/
+    int     atom;           /*1 if hist is shared and needs atomic increments*/
+    long    nrej;           /*events rejected (det or energy out of range)*/
+    int     err;            /*non-zero if a read error occurred*/
+};
+
+int     ar_expr(char **p, int lvl, struct arval *r, int n);
+int     ar_load(char name[]);
+int     ar_op(struct arval *a, struct arval *b, char op, int n);
+int     ar_stage(char name[], int numch, int md, int of);
+int 	ascii_read(char name[]);
+void 	ascii_write(char name[], int numch);
+int     bg_stage(char name[], int numch, int md, int of);
+void 	chan_num_ext(char fin[], char fout[], int *numch, char ext[]);
+void	check_ext(char fin[], char ext[]);
+void    chn_write(char name[], int numch);
+int  	col_determ(FILE *file);
+long 	convert_bytes(char name[]);
+int 	cswap4(int decim);
+int 	cswap2(int decim);
+int     csv_num(char out[], double v);
+int     csv_str(char out[], char s[]);
+void	decode_mspec_name(char name[], int *set, int *mxsp, int *numch,
+	    int *sz, int bytes);
+int     fail_done(int rc);
+void    fail_note(char entry[], char why[]);
+int     fail_open(char list[]);
+void    fail_report(char entry[], char why[]);
+int 	file_status(char name[], char ext[], int len);
+int 	genie_read(char name[]);
+void 	get_ans(char ans[], int num);
+int     get_entry(FILE *fp, char name[], float g[]);
+void 	get_line(char ans[], int len);
+void    get_line_file(FILE *file, char ans[], int len);
+int 	get_mode(int md);
+int     get_nthr(void);
+int     get_ofmt(void);
+int     get_opts(int argc, char *argv[], int *srv);
+void 	get_pars(float pars[], int num);
+void 	get_val(float *val);
+int     idx_read(char name[], long bytes);
+int     idx_write(char name[], int set, int mxsp, int numch, int sz,
+            char type[]);
+void 	itoa(int n, char s[]);
+void    jnl_begin(char entry[]);
+int     jnl_cmp(const void *a, const void *b);
+void    jnl_close(int rc);
+void    jnl_end(void);
+void    jnl_filter(char **names, int *n);
+int     jnl_open(char list[]);
+void    jnl_out(char name[]);
+int     jnl_skip(char entry[]);
+void    json_num(FILE *fp, double v);
+void    json_str(FILE *fp, char s[]);
+void    list_side(char out[], char list[], char ext[]);
+char   *load_file(char name[], long *len);
+char  **load_lst(char listname[], int *n);
+unsigned int lm_field(unsigned char *p, int sz, int swap);
+long    lm_hist(char name[], unsigned int *hist, int nthr);
+void   *lm_thread(void *arg);
+int 	maestro_read(char name[]);
+int     meta_date(int *y, int *mo, int *d, int *hms);
+void    meta_json(FILE *fp, char file[], struct specmeta *m, int all);
+int     meta_read(char name[]);
+void    meta_write(char name[]);
+int     mode_num(char c);
+void    mspec_type(char name[], char type[]);
+int     npy_header(char hdr[], char descr[], int rows, int cols);
+int     npy_mspec(char name[], char outname[]);
+void    npy_write(char name[], int numch);
+void 	num_fname(char name[], int num);
+int     out_claim(char name[]);
+int     out_close(FILE *fp);
+void    out_fail(char name[], char entry[]);
+FILE   *out_open(char name[], char mode[]);
+int     par_fork(int *nw);
+int     par_wait(int w, int status);
+void   *pipe_read(void *arg);
+void    pipe_start(char **names, int n, int w, int nw, int own);
+void    pipe_stop(void);
+void   *pipe_write(void *arg);
+int     pyr_write(char name[], int numch);
+int     probe_chn(int fd, long size, struct specmeta *m);
+int     probe_file(char name[], struct specmeta *m);
+int     probe_rad(int fd, long size, struct specmeta *m);
+int     probe_spe(int fd, long size, struct specmeta *m);
+void   *probe_thread(void *arg);
+int     proc_stages(char name[], int numch, int md, int of);
+int     put_opts(char req[]);
+int 	rad_read(char name[]);
+int     raw_write(char name[], int numch);
+int     read_any(char name[]);
+int     read_layout(char name[]);
+void 	rad_write(char name[], int numch);
+int 	read_lst(char inname[], int lst);
+int     read_spec(char name[], int md);
+int     rebin(float in[], float out[], int numch);
+void    rebin_map(float y[], float out[], int numch, int nout, float g[],
+            int ch[], int nch);
+int     roi_areas(struct roires *r, int numch);
+int     roi_file(char name[], int lo[], int hi[]);
+int     roi_table(char name[], char **names, int n, char roif[]);
+int     run_conv(int argc, char *argv[]);
+void 	reverse(char s[]);
+int     scan_num(char **p, char *e, float *v);
+void 	set_ext(char name[], char ext[]);
+void    shm_write(char name[], int numch);
+void 	skip_hash(FILE *file);
+int     sniff_fmt(char name[]);
+void    snip_bg(float y[], float bg[], int n, int iter, int win, int lls);
+int     sock_client(char name[], int argc, char *argv[]);
+int     sock_serve(char name[]);
+void    sock_work(int lfd);
+int     sp_magic(char name[]);
+int     sp_pack(int numch);
+int     sp_read(char name[]);
+void    sp_write(char name[], int numch, int bin);
+int     spe_index(char *buf, char *e, char *sec[], int max);
+int     spe_read(char name[]);
+void    spe_write(char name[], int numch);
+int     spec_close(FILE *fp);
+unsigned long long spec_hash(unsigned int *p, long n);
+FILE   *spec_open(char name[], char mode[]);
+int     spec_sums(char name[], unsigned long long sum[], int mxsp, long len);
+void    stat_done(void);
+void    stat_spec(char name[], int numch);
+void    store_colours();
+void    store_formats();
+int     sum_file(char name[], unsigned long long sum[], int mxsp, long len,
+            int wr);
+void    sum_opts(char opts[]);
+void 	swapb2(char *buf);
+void 	swapb4(char *buf);
+void    walk_emit(char name[]);
+char  **walk_load(int *n);
+int     walk_match(char name[]);
+int     walk_next(char name[]);
+void    walk_push(char item[], char type);
+void    walk_run(void);
+int     walk_start(int n, char *in[]);
+void    walk_stop(void);
+void   *walk_thread(void *arg);
+int     win_crop(int numch);
+int     win_read(char name[], int md);
+int     write_mspec(char name[], char **names, int n, int numch);
+void    write_ofmt(char name[], int numch, int of);
+int     write_probe(char name[], char **names, struct specmeta *m, int n);
+int     write_spec(char name[], int numch, int md);
+void 	xtrack_read(char name[], int *numch, int mxsp, int sz, int nsp,
+	    int flg);
+void 	xtrack_write(char name[], int numch);
+        
+float spectrum[CHMAX], gain[3], rbg[3];
+int md, ofmt = 1, batch = 0, ovwr = 0, inlin = 0, wlo = 0, whi = -1;
+int statfd = -1, nstw = 0, stw[NSTW][2];
+int bgit = 0, bgwin = 0, bglls = 0, bgout = 0, arerr = 0, rbfac = 0;
+int pyrout = 0, metaout = 1, failfd = -1, nfail = 0;
+char ext[NUMOPT][11], exti[NUMOPT][11], fmti[NUMOPT][14], fmt[NUMOPT][14];
+char oext[NUMOFMT][11], ofmtn[NUMOFMT][14];
+char clr[10][12];
+char sockname[CHLEN] = "", outopt[CHLEN] = "", layopt[CHLEN] = "";
+char stname[CHLEN] = "", roiopt[CHLEN] = "", aropt[EXPLEN] = "";
+char failopt[CHLEN] = "", failname[CHLEN+4] = "", walkflt[CHLEN] = "";
+/*input sent inline to the server, served by spec_open() instead of the file*/
+struct memfile {
+    char    name[CHLEN];
+    char    *buf;
+    long    len;
+} memfile;
+/* ++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+/* ++++++++++++++++++++++++++++++++++ MAIN ++++++++++++++++++++++++++++++++++ */
+/* ++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+int main(int argc, char *argv[])
+{
+    extern float gain[3];
+    extern int	md, batch;
+    extern char sockname[CHLEN];
+    int     i, srv = 0;
+    
+    /*store colours*/
+    store_colours();
+    /*store extensions and formats of the options*/
+    store_formats();
+    
+    md = 0;
+    for (i = 0; i < 3; i++) gain[i] = 0.0;
+    
+    /*options select the mode etc. for unattended runs, or the server*/
+    if ( (i = get_opts(argc, argv, &srv)) < 0) return -1;
+    if (srv == 1) return sock_serve(sockname);
+    if (srv == 2) return sock_client(sockname, argc, argv);
+    
+    if (! batch)
+    {
+        i = (int)pow(10,MXNUMDIG) - 1;
+        printf("\n \t \t     *****Welcome to SPEC_CONV*****\n"
+	        "\tThis program converts spectra between RadWare, Ascii,\n"
+	        "\tXtrack (GASPWARE) and Ortec (binary Chn & ASCII Spe) formats,\n"
+                "\tincluding multiple-spectra (<%d) Xtrack files, e.g. from AGATA.\n"
+	        "\tand can gainmatch spectra.\n"
+	        "\t(Ascii means (y) or (x y) data starting from channel zero)\n"
+	        "\tComment lines starting with # are ignored at the front of\n"
+	        "\tascii spectra. The 1 or 2 col. format is auto-detected.\n\n",i); 
+    }
+/*    printf("    Input ext   Output ext  Format\n");
+    for (i = 0; i < NUMOPT; i++)
+        printf("    %-11s %-11s %-14s\n",exti[i], ext[i], fmti[i]);
+    printf("\n");*/
+       
+    /*remaining arguments as for a plain "spec_conv [file]"*/
+    i = run_conv(argc - optind + 1, argv + optind - 1);
+    walk_stop();
+    stat_done();
+    jnl_close(i);
+    return fail_done(i);
+} /*END main()*/
+
+/*==========================================================================*/
+/* run_conv: run conversion(s) for arguments as main() without options      */
+/****************************************************************************/
+int run_conv(int argc, char *argv[])
+{
+    extern float spectrum[CHMAX], gain[3];
+    extern int	md, ofmt, batch, ovwr;
+    extern char ext[NUMOPT][11], exti[NUMOPT][11]; 
+    extern char fmti[NUMOPT][14], fmt[NUMOPT][14];
+    extern char oext[NUMOFMT][11], ofmtn[NUMOFMT][14];
+    float   spbuf[CHMAX], calib = 2.000, tmpf = -1.0, g[3];
+    long    bytes = 0, nev = 0;
+    int     flg = 1, fn = 0, i = 0, j = 0, lst = 3, mxsp = 0, nsp = -1;
+    int     k = 0, numch = CHMAX, set = 1, sz = 4, nthr = 1, idx = 0, wn = 0;
+    int     nh = 0;
+    unsigned int *hist = NULL;
+    unsigned long long *hnew = NULL, *hold = NULL;
+    char    **names = NULL;
+    struct  probejob pjob;
+    pthread_t tid[MXTHR];
+    char    inname[CHLEN] = "", outname[CHLEN] = "", ans[CHLEN] = "";
+    char    tmp[CHLEN+4];
+    struct  stat statbuf;
+    FILE    *fl;
+    
+    /*argv[i] is the ith argument, i.e. first is the program name;
+        directories, patterns and several files are searched for spectra
+        as if listed in a list file*/
+    if (argc > 2 || (argc == 2 && (memfile.buf == NULL
+            || strcmp(memfile.name, argv[1])) && (stat(argv[1], &statbuf)
+            ? strpbrk(argv[1], "*?[") != NULL : S_ISDIR(statbuf.st_mode))))
+    {
+        wn = argc - 1;
+        lst = -1;
+        strcpy(inname, WALKLST);
+    }
+    else if ( argc > 2 || (argc == 2 && (stat(argv[1], &statbuf))
+            && (memfile.buf == NULL || strcmp(memfile.name, argv[1])))
+        || (argc < 2 && batch) )
+    {
+	printf("\nUnrecognised arguments...usage: spec_conv\n"
+		" or: spec_conv SpectrumFileName\n"
+		" or: spec_conv -m mode [-f ofmt] [-o outname] [-L layout]"
+		" [-g A0,A1,A2] [-c n|A0,A1,A2] [-A expr [-E]] [-B iter[,win]]"
+		" [-T] [-K] [-P] [-N] [-F report] [-I filter] [-y]"
+		" FileName|Dir|'Pattern' ...\n"
+		" or: spec_conv -S socket\n"
+		" or: spec_conv -C socket [-b] -m mode ... FileName\n");
+	if (argc == 2) printf(" ***File %s does not exist\n",argv[1]);
+	return -1;
+    }
+    else if (argc == 2)
+    {
+        strcpy(inname,argv[1]);
+	/*printf("Filename = %s\n",inname);*/
+	lst = 2;
+        /*read first non-comment line of file...
+            if it's the name of an existing file assume a list file*/
+    	if ((fl = spec_open(inname, "r" )) == NULL)
+    	{
+    	    printf("Cannot open file: %s \n", inname);
+    	    return -1;			
+    	}
+        if ( (i = get_entry(fl, ans, NULL)) == 1)
+        {
+           /*a gainmatching list has coefficients after the name*/
+           if (stat(ans, &statbuf) && ! fseek(fl, 0L, SEEK_SET))
+               i = get_entry(fl, ans, g);
+           if (i == 1 && ! stat(ans, &statbuf))
+           {
+              /*file exists...assuming list file*/
+              lst = -1;
+              printf("List filename = %s\n",inname);
+           }
+           else printf("Spectrum filename = %s\n",inname);
+        }
+        fclose(fl);
+    }
+    
+    /*statistics table of every spectrum written (-s), rows are appended
+        by stat_spec() so that worker processes can add theirs; it is built
+        as stname.tmp and renamed by stat_done()*/
+    if (strlen(stname) && statfd < 0)
+    {
+        sprintf(tmp, "%s.tmp", stname);
+        if ( (statfd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND,
+                0666)) < 0)
+        {
+            printf("Cannot open file: %s \n", stname);
+            return -1;
+        }
+        sprintf(ans, "spectrum,channels,total,max,max_channel,first,last,"
+                "centroid");
+        for (i = 0; i < nstw; i++)
+            sprintf(ans + strlen(ans), ",win_%d-%d", stw[i][0], stw[i][1]);
+        strcat(ans, "\n");
+        if (write(statfd, ans, strlen(ans)) < 0) ;
+    }
+    
+    /*mode may already be set by the -m option*/
+    if (md == 0 && (md = get_mode(md)) == 0) return 0;
+    if (wn > 0 && walk_start(wn, argv + 1) < 0) return -1;
+    
+    while (lst == 3)
+    {        
+	printf("Read spectrum names from list file (y/n) \n");
+	get_ans(ans,1);
+	if (ans[0] == 'y' || ans[0] == 'Y') lst = 1;
+	else if (ans[0] == 'n' || ans[0] == 'N') lst = 0;
+    }    
+
+    /* simple spectrum read/write */
+    if ( (md >= 1 && md <= 5) || md == 8 || md == 9 || md == 10)
+    {
+	while (flg == 1)
+	{
+	    numch = CHMAX;
+	    /*if a list file*/
+	    if (lst == 1 || lst == -1) fn = read_lst(inname,lst);
+	    else if (lst == 0)
+	    {
+    	    	printf("Type %s filename inc. extension (eg %s):\n",
+                        fmti[md-1],exti[md-1]);
+	    	get_line(inname, CHLEN);
+	    }
+	    if (lst != 1 && lst != -1) flg = -1;
+            
+	    if (fn == -1) return 0;
+            
+	    /*zero spectrum array*/    	
+    	    for (i = 0; i < CHMAX; i++) spectrum[i] = 0.0;
+    	    	
+    	    /*read spectrum file*/
+	    if ( (numch = read_spec(inname, md)) <= 0)
+            {
+                sprintf(ans, "cannot read %s spectrum", fmti[md-1]);
+                fail_note(inname, ans);
+                continue;
+            }
+	    /* if channels is not multiple of 4096 or <1024, ask for length*/
+    	    chan_num_ext(inname, outname, &numch, ext[md-1]);
+
+	    strcpy(outname,inname);
+    	    set_ext(outname, ext[md-1]);
+    	    /*check file status*/
+    	    if (file_status(outname, ext[md-1], CHLEN) < 0) continue;
+    	                
+    	    printf(" %s", inname);
+	    write_spec(outname, numch, md);
+	}
+    }/*END simple spectrum read/write */        
+            
+    /*Xtrackn format options*/    
+    if ( md == 6 || md == 7 )
+    {
+	while (flg == 1)
+	{
+	    /*reset some parameters*/
+	    if (mxsp < 1)
+	    {
+		numch = CHMAX;
+		set = 1;
+	    }
+	    /*if a list file*/
+	    if ( (lst == 1 || lst == -1) && mxsp <= 1) fn = read_lst(inname,lst);
+	    else if (lst == 0 && nsp == -1)
+	    {
+    	    	printf("Type %s filename inc. extension (eg %s):\n",
+                        fmti[md-1],exti[md-1]);
+	    	get_line(inname, CHLEN);
+	    }
+	    if (fn == -1) return 0;
+	    
+	    strcpy(outname, inname);
+	    if (lst != 1 && lst != -1) flg = -1;
+	    
+	    /*modes 6 and 7 allow for extraction/conversion of
+	    	multiple CHMAX channel spectrum in 1 file*/
+	    check_ext(inname, exti[md-1]);
+	    if (mxsp <= 1 && stat(inname, &statbuf))
+	    {
+	        fail_note(inname, "no such file");
+	        continue;
+	    }
+    	    /*get and print file size*/
+     	    if (mxsp <= 1) bytes = convert_bytes(inname);
+	
+	    /*a layout index replaces decoding the name and probing*/
+	    if (mxsp < 1 && (idx = (idx_read(inname, bytes) > 0)) )
+	    {
+	        set = layidx.set;
+	        mxsp = layidx.mxsp*layidx.set;
+	        numch = layidx.numch;
+	        sz = layidx.sz;
+	    }
+	    
+	    /*check file name for "__" surrounding mult. spec info*/
+            if ( mxsp < 1 && strchr(inname,'_') && ! strncmp( strchr(inname,'_'), "__", 2 ) )
+	        decode_mspec_name(inname, &set, &mxsp, &numch, &sz, bytes);
+
+	    /*for a standard spectrum check numch is compatible with
+	        the filesize*/
+    	    while ( mxsp < 1 && 
+	        (mxsp = (int)( bytes/(numch*sizeof(unsigned int)) )) < 1
+	            && numch > 50) numch /= 2;
+	    
+	    /*record the layout (and ranges) of a multiple spectrum file once*/
+	    if (mxsp > 1 && (! idx || ! layidx.fresh))
+	    {
+	        mspec_type(inname, ans);
+	        idx = (idx_write(inname, set, mxsp/set, numch, sz, ans) == 0
+	            && idx_read(inname, bytes) > 0);
+	    }
+    
+    	    if ( mxsp > 1 && nsp == -1 && batch) nsp = mxsp;
+    	    if ( mxsp > 1 && nsp == -1)
+    	    {
+	        while (1)
+	        {
+	            printf("Enter spectrum number you require"
+	                " (0-%d, %d for all)\n",mxsp-1,mxsp);
+	            get_val(&tmpf);
+	            nsp = (int)tmpf;
+	            j = 0;
+	            if (nsp >= 0 && nsp <= mxsp) break;
+	        }
+    	    }
+    	    else if (mxsp == 1)
+    	    {
+	        nsp = 0;
+	        j = nsp;
+    	    }
+	
+    	    /*set output filename*/
+/*    	    if (mxsp > 1 && nsp == mxsp)*/
+    	    if (mxsp > 1)
+	    {
+	        if (nsp != mxsp) j = nsp;
+	        flg = 1;
+	        strcpy(outname,inname);
+                num_fname(outname, j);
+	    }
+	    
+	    /*all spectra: only those whose checksum changed since the last
+	        run with the same options (or without an output) are extracted
+	        again, all of them with -y*/
+	    k = 0;
+	    if (mxsp > 1 && nsp == mxsp)
+	    {
+	        if (j == 0)
+	        {
+	            hnew = (unsigned long long *) calloc(2*mxsp, sizeof(*hnew));
+	            if (hnew) hold = hnew + mxsp;
+	            nh = mxsp;
+	            if (hnew && spec_sums(inname, hnew, mxsp, (long)numch*sz) < 0)
+	                memset(hnew, 0, mxsp*sizeof(*hnew));
+	            else if (hnew
+	                && sum_file(inname, hold, mxsp, (long)numch*sz, 0) == mxsp)
+	                printf("Checksums of the last run found\n");
+	            else if (hnew) memset(hold, 0, mxsp*sizeof(*hold));
+	        }
+	        strcpy(ans, outname);
+	        set_ext(ans, ext[md-1]);
+	        if (hnew && hnew[j] == hold[j] && hnew[j] != 0 && ! ovwr
+	                && stat(ans, &statbuf) == 0) k = 1;
+	    }
+	    /*empty according to the index: nothing to read*/
+	    if (! k && idx && layidx.fresh && layidx.last[j] < 0) k = 2;
+	    
+	    /*zero spectrum array*/    	
+    	    for (i = 0; i < CHMAX; i++) spectrum[i] = 0.0;
+            
+    	    if (numch > 50 && ! k) xtrack_read(inname, &numch, mxsp, sz, j, flg);
+            
+	    j++;
+	    /*reset parameters if last spectrum read*/
+	    if ( ( (mxsp > 1) && ((nsp == mxsp && j == mxsp)
+	            || (nsp != mxsp))) || mxsp == 1)
+	    {
+	        idx = 0;
+	        set = 1;
+	        mxsp = 0;
+	        nsp = -1;
+	        /*only break while loop if no more spectra to process*/
+	        if (lst != 1 && lst != -1) flg = -1;
+	    }
+	    
+	    if (numch <= 0 || numch > CHMAX)
+	    {
+	        sprintf(ans, "%d channels", numch);
+	        fail_note(inname, ans);
+	    }
+	    else if (k == 1) printf(" %s unchanged\n", ans);
+	    else
+	    {
+    	        set_ext(outname, ext[md-1]);
+    	        strcpy(ans, outname);
+    	        /*check file status*/
+    	        if (file_status(outname, ext[md-1], CHLEN) == 0)
+    	        {
+    	            printf(" %s", inname);
+	            /*the new checksum is kept only once its output (under
+	                the name looked for next time) is written*/
+	            if (write_spec(outname, win_crop(numch), md) == 0 && hnew
+	                    && ! strcmp(ans, outname)) hold[j-1] = hnew[j-1];
+    	        }
+	    }
+	    
+	    /*save the checksums after the last spectrum of the file*/
+	    if (hnew && mxsp == 0)
+	    {
+	        if (numch > 0) sum_file(inname, hold, nh, (long)numch*sz, 1);
+	        free(hnew);
+	        hnew = NULL;
+	    }
+    	}
+    } /*END Xtrackn ==> format options*/ 
+    
+    /* Histogram list-mode event file(s) into per-detector spectra */
+    if (md == 11)
+    {
+        if (batch) strcpy(ans, layopt);
+        else
+        {
+            printf("Type list-mode layout descriptor filename:\n");
+            get_line(ans, CHLEN);
+        }
+        if (read_layout(ans) < 0) return -1;
+        ofmt = get_ofmt();
+        strcpy(ext[md-1], oext[ofmt]);
+        strcpy(fmt[md-1], ofmtn[ofmt]);
+        
+        nthr = get_nthr();
+        /*private histograms per thread unless too large, then one shared*/
+        if ( (long)nthr*lmlayout.ndet*lmlayout.numch*sizeof(unsigned int)
+                > LMPRIV ) i = 1;
+        else i = nthr;
+        if ( (hist = (unsigned int *) malloc( (long)i*lmlayout.ndet
+                *lmlayout.numch*sizeof(unsigned int) )) == NULL)
+        {
+            printf("Cannot allocate memory for %d histograms\n",
+                i*lmlayout.ndet);
+            return -1;
+        }
+        
+	while (flg == 1)
+	{
+	    /*if a list file*/
+	    if (lst == 1 || lst == -1) fn = read_lst(inname,lst);
+	    else if (lst == 0)
+	    {
+    	    	printf("Type %s filename inc. extension (eg %s):\n",
+                        fmti[md-1],exti[md-1]);
+	    	get_line(inname, CHLEN);
+	    }
+	    if (lst != 1 && lst != -1) flg = -1;
+            
+	    if (fn == -1) break;
+            
+            /*histogram all events; hist[0..ndet*numch) holds the result*/
+            if ( (nev = lm_hist(inname, hist, nthr)) < 0)
+            {
+                fail_note(inname, "cannot histogram events");
+                continue;
+            }
+            
+            /*write one spectrum per detector with counts*/
+            numch = lmlayout.numch;
+            for (i = 0; i < lmlayout.ndet; i++)
+            {
+                for (j = 0, tmpf = 0.0; j < numch; j++)
+                {
+                    spectrum[j] = (float)hist[(long)i*numch + j];
+                    tmpf += spectrum[j];
+                }
+                if (tmpf == 0.0) continue;
+                
+	        strcpy(outname,inname);
+                num_fname(outname, i);
+    	        set_ext(outname, ext[md-1]);
+    	        /*check file status*/
+    	        if (file_status(outname, ext[md-1], CHLEN) < 0) continue;
+    	        
+    	        printf(" %s det %d", inname, i);
+	        write_ofmt(outname, numch, ofmt);
+            }
+        }
+        free(hist);
+    } /*END list-mode ==> spectra*/
+    
+    /* Probe headers/trailers only and tabulate metadata as CSV or JSON */
+    if (md == 12)
+    {
+        if (lst == 1 || lst == -1)
+        {
+            if (lst == 1)
+            {
+                printf("Type filename containing list of spectrum file names:\n");
+                get_line(inname, CHLEN);
+            }
+            if ( (names = load_lst(inname, &fn)) == NULL) return -1;
+        }
+        else
+        {
+            if (lst == 0)
+            {
+                printf("Type spectrum filename inc. extension (eg .Chn):\n");
+                get_line(inname, CHLEN);
+            }
+            fn = 1;
+            names = (char **) malloc(sizeof(char *));
+            names[0] = inname;
+        }
+        if (batch)
+        {
+            strcpy(outname, strlen(outopt) ? outopt : inname);
+            if (! strlen(outopt)) set_ext(outname, ext[md-1]);
+        }
+        else
+        {
+            printf("Type output table filename (%s for CSV, .json for JSON):\n",
+                    ext[md-1]);
+            get_line(outname, CHLEN);
+        }
+        if (strrchr(outname,'.') == NULL) set_ext(outname, ext[md-1]);
+        if (file_status(outname, ext[md-1], CHLEN) < 0)
+        {
+            if (lst == 1 || lst == -1) for (i = 0; i < fn; i++) free(names[i]);
+            free(names);
+            return 0;
+        }
+        
+        pjob.names = names;
+        pjob.n = fn;
+        pjob.next = 0;
+        pjob.meta = (struct specmeta *) calloc(fn, sizeof(struct specmeta));
+        /*probing is I/O-bound so use the maximum number of threads*/
+        nthr = fn < MXTHR ? fn : MXTHR;
+        for (i = 0; i < nthr; i++)
+            if (pthread_create(&tid[i], NULL, probe_thread, &pjob) != 0) break;
+        if (i == 0) probe_thread(&pjob);
+        for (j = 0; j < i; j++) pthread_join(tid[j], NULL);
+        
+        for (i = 0, j = 0; i < fn; i++) if (pjob.meta[i].err) j++;
+        if (write_probe(outname, names, pjob.meta, fn) == 0)
+            printf("Probed %d files (%d not decoded) ==> %s\n", fn, j, outname);
+        
+        free(pjob.meta);
+        if (lst == 1 || lst == -1) for (i = 0; i < fn; i++) free(names[i]);
+        free(names);
+    } /*END probe headers ==> table*/
+    
+    /* Integrate ROIs (from each .Spe or a ROI file) ==> table */
+    if (md == 16)
+    {
+        if (lst == 1)
+        {
+            printf("Type filename containing list of spectrum file names:\n");
+            get_line(inname, CHLEN);
+        }
+        else if (lst == 0)
+        {
+            printf("Type spectrum filename inc. extension (eg .Spe):\n");
+            get_line(inname, CHLEN);
+        }
+        if (lst == 1 || lst == -1)
+        {
+            if ( (names = load_lst(inname, &fn)) == NULL) return -1;
+        }
+        else
+        {
+            fn = 1;
+            names = (char **) malloc(sizeof(char *));
+            names[0] = (char *) malloc(CHLEN);
+            strcpy(names[0], inname);
+        }
+        if (! batch)
+        {
+            printf("Type ROI filename (lines of: first last channel)"
+                    " [<Enter> for the $ROI of each .Spe]:\n");
+            get_line(roiopt, CHLEN);
+        }
+        if (batch)
+        {
+            strcpy(outname, strlen(outopt) ? outopt : inname);
+            if (! strlen(outopt)) set_ext(outname, ext[md-1]);
+        }
+        else
+        {
+            printf("Type output table filename (%s):\n", ext[md-1]);
+            get_line(outname, CHLEN);
+        }
+        if (strrchr(outname,'.') == NULL) set_ext(outname, ext[md-1]);
+        if (file_status(outname, ext[md-1], CHLEN) == 0)
+            roi_table(outname, names, fn, roiopt);
+        
+        for (i = 0; i < fn; i++) free(names[i]);
+        free(names);
+    } /*END ROIs ==> table*/
+    
+    /* Convert a list of mixed formats, sniffing the format of each file */
+    if (md == 13)
+    {
+        if (lst == 1)
+        {
+            printf("Type filename containing list of spectrum file names:\n");
+            get_line(inname, CHLEN);
+        }
+        else if (lst == 0)
+        {
+            printf("Type spectrum filename:\n");
+            get_line(inname, CHLEN);
+        }
+        /*files found in directories are converted as they are found*/
+        if (walker.on)
+        {
+            fail_open(inname);
+            jnl_open(inname);
+        }
+        else if (lst == 1 || lst == -1)
+        {
+            if ( (names = load_lst(inname, &fn)) == NULL) return -1;
+            fail_open(inname);
+            jnl_open(inname);
+            jnl_filter(names, &fn);
+        }
+        else
+        {
+            fn = 1;
+            names = (char **) malloc(sizeof(char *));
+            names[0] = strdup(inname);
+        }
+        ofmt = get_ofmt();
+        strcpy(ext[md-1], oext[ofmt]);
+        strcpy(fmt[md-1], ofmtn[ofmt]);
+        while (! batch)
+        {
+            printf("Overwrite existing output files (y/n)?\n");
+            get_ans(ans,1);
+            if (ans[0] == 'y' || ans[0] == 'Y') ovwr = 1;
+            else if (ans[0] != 'n' && ans[0] != 'N') continue;
+            break;
+        }
+        
+        /*no prompts from here on: workers run concurrently; each counts
+            its failures, added up by par_wait()*/
+        batch = 1;
+        nthr = get_nthr();
+        if (nthr > fn && ! walker.on) nthr = fn;
+        if (nthr < 1) nthr = 1;
+        k = nfail;
+        if ( (oclaim = (unsigned long long *) mmap(NULL,
+                NCLAIM*sizeof(*oclaim), PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_ANONYMOUS, -1, 0)) == MAP_FAILED)
+            oclaim = NULL;
+        set = par_fork(&nthr);
+        /*found files are shared out by the queue, one at a time*/
+        if (set > 0 && walker.on)
+        {
+            close(walker.fd[1]);
+            walker.fd[1] = -1;
+        }
+        pipe_start(names, fn, set, nthr, 0);
+        for (i = set; walker.on || i < fn; i += nthr)
+        {
+            jnl_end();
+            if (! walker.on) strcpy(inname, names[i]);
+            else if (walk_next(inname) < 0) break;
+            else if (jnl_skip(inname)) continue;
+            jnl_begin(inname);
+            if ( (md = sniff_fmt(inname)) < 0)
+            {
+                fail_note(inname, stat(inname, &statbuf) ? "no such file"
+                        : "unrecognised format");
+                md = 13;
+                continue;
+            }
+            printf("%s: %s format\n", inname, fmti[md-1]);
+            
+            /*Xtrack: one or more spectra of 4 byte channels*/
+            if (md == 6)
+            {
+                numch = CHMAX;
+                mxsp = 0;
+                nsp = 1;
+                bytes = convert_bytes(inname);
+                if (idx_read(inname, bytes) > 0)
+                {
+                    mxsp = layidx.mxsp*layidx.set;
+                    numch = layidx.numch;
+                    sz = layidx.sz;
+                }
+                else if (strchr(inname,'_') && ! strncmp( strchr(inname,'_'), "__", 2 ) )
+                    decode_mspec_name(inname, &nsp, &mxsp, &numch, &sz, bytes);
+                if (mxsp < 1 || sz != 4)
+                {
+                    mxsp = 1;
+                    numch = bytes/4 < CHMAX ? bytes/4 : CHMAX;
+                }
+            }
+            else mxsp = 1;
+            
+            for (nsp = 0; nsp < mxsp; nsp++)
+            {
+    	        memset(spectrum, 0, sizeof(spectrum));
+                if (md == 6 && layidx.fresh && layidx.mxsp*layidx.set == mxsp
+                    && layidx.last[nsp] < 0) ;
+                else if (md == 6) xtrack_read(inname, &numch, mxsp, 4, nsp, mxsp > 1);
+                else numch = read_spec(inname, md);
+                if (numch <= 0 || numch > CHMAX)
+                {
+                    sprintf(ans, "cannot read %s spectrum", fmti[md-1]);
+                    fail_note(inname, ans);
+                    break;
+                }
+                strcpy(outname, inname);
+                if (mxsp > 1) num_fname(outname, nsp);
+                set_ext(outname, oext[ofmt]);
+                if (! strcmp(outname, inname))
+                {
+                    printf("%s is already %s ...skipped\n", inname, ofmtn[ofmt]);
+                    break;
+                }
+                /*e.g. d.txt and d.spt both ==> d.spec: the first one wins*/
+                if (out_claim(outname) < 0)
+                {
+                    snprintf(ans, CHLEN, "output %s also from another input",
+                            outname);
+                    fail_note(inname, ans);
+                    continue;
+                }
+                if (file_status(outname, oext[ofmt], CHLEN) < 0) continue;
+                printf(" %s", inname);
+                write_ofmt(outname, win_crop(numch), ofmt);
+            }
+            md = 13;
+        }
+        jnl_end();
+        pipe_stop();
+        nfail = k + par_wait(set, nfail - k);
+        if (oclaim) munmap(oclaim, NCLAIM*sizeof(*oclaim));
+        oclaim = NULL;
+        
+        for (i = 0; i < fn; i++) free(names[i]);
+        free(names);
+    } /*END auto-detected formats ==> format*/
+    
+    /* Pack a list of spectra into one multiple spectrum Xtrack file */
+    if (md == 14)
+    {
+        if (lst == 1 || lst == 0)
+        {
+            printf("Type filename containing list of spectrum file names:\n");
+            get_line(inname, CHLEN);
+        }
+        if ( (names = load_lst(inname, &fn)) == NULL) return -1;
+        fail_open(inname);
+        
+        /*common length from the headers: the longest, in units of 1024*/
+        pjob.meta = (struct specmeta *) calloc(fn, sizeof(struct specmeta));
+        for (i = 0, j = 0, k = 0; i < fn; i++)
+        {
+            if (probe_file(names[i], &pjob.meta[i]) == 0)
+            {
+                if (pjob.meta[i].channels > j) j = pjob.meta[i].channels;
+            }
+            else k++;
+        }
+        free(pjob.meta);
+        if ( (j = ((j + 1023)/1024)*1024) > CHMAX || j == 0) j = CHMAX;
+        printf("%d spectra (%d without a readable header)\n",fn,k);
+        if (! batch)
+        {
+            printf("Enter channels per spectrum [<Enter> for %d]\n",j);
+            get_val(&tmpf);
+        }
+        else tmpf = 0.0;
+        if ( (numch = (int)tmpf) <= 0) numch = j;
+        if (numch > CHMAX)
+        {
+            printf("Maximum is %d channels\n", CHMAX);
+            numch = CHMAX;
+        }
+        
+        /*name must decode as __set_mxsp_numch_UI__, so the first '_'
+            must be the start of the layout*/
+        while (1)
+        {
+            if (batch)
+            {
+                strncpy(ans, strlen(outopt) ? outopt : inname, CHLEN-31);
+                ans[CHLEN-31] = '\0';
+            }
+            else
+            {
+                printf("Type output base name (without extension):\n");
+                get_line(ans, CHLEN-30);
+            }
+            if (strrchr(ans,'/') && strchr(ans,'_') < strrchr(ans,'/')
+                    && strchr(ans,'_'))
+            {
+                printf("Directory names must not contain '_'\n");
+                if (batch) return -1;
+                continue;
+            }
+            if (strchr(ans,'.')
+                && (! strrchr(ans,'/') || strrchr(ans,'.') > strrchr(ans,'/')))
+                *strrchr(ans,'.') = '\0';
+            for (i = 0; ans[i] != '\0'; i++) if (ans[i] == '_') ans[i] = '-';
+            if (strlen(ans) > 0) break;
+        }
+        sprintf(outname, "%s__%d_%d_UI__%s", ans, fn, numch, ext[md-1]);
+        if (file_status(outname, ext[md-1], CHLEN) == 0
+                && write_mspec(outname, names, fn, numch) == 0)
+        {
+            idx_write(outname, 1, fn, numch, 4, "UI");
+            /*check the layout is recovered from the name*/
+            bytes = convert_bytes(outname);
+            k = batch;
+            batch = 1;
+            set = 1;
+            mxsp = 0;
+            decode_mspec_name(outname, &set, &mxsp, &j, &sz, bytes);
+            batch = k;
+            if (mxsp != fn || j != numch || sz != (int)sizeof(unsigned int))
+                printf("%s***Layout of %s does not decode from its name%s\n",
+                        clr[1],outname,clr[0]);
+        }
+        for (i = 0; i < fn; i++) free(names[i]);
+        free(names);
+    } /*END spectra ==> multiple spectrum Xtrack*/
+    
+    /* Multiple spectrum Xtrack file ==> one 2D NumPy array */
+    if (md == 15)
+    {
+	while (flg == 1)
+	{
+	    if (lst == 1 || lst == -1) fn = read_lst(inname,lst);
+	    else if (lst == 0)
+	    {
+    	    	printf("Type %s filename inc. extension (eg %s):\n",
+                        fmti[md-1],exti[md-1]);
+	    	get_line(inname, CHLEN);
+	    }
+	    if (lst != 1 && lst != -1) flg = -1;
+	    if (fn == -1) return 0;
+            
+	    strcpy(outname,inname);
+    	    set_ext(outname, ext[md-1]);
+    	    if (file_status(outname, ext[md-1], CHLEN) < 0) continue;
+            if (npy_mspec(inname, outname) < 0)
+                fail_note(inname, "cannot convert to NumPy");
+        }
+    } /*END Xtrack multi ==> NumPy 2D*/
+        
+    /* Read in RadWare spectrum, GAINMATCH, and output as RadWare spectrum */
+    if (md == NUMOPT)
+    {
+        printf("md = %d\n",md);
+	while (flg == 1)
+	{
+	    numch = CHMAX;
+	    /*if a list file i.e. extension not .spe*/
+            /*strcmp returns zero if identical, i.e. if not equal to NULL*/
+            if (lst == 2 && strcmp( (strrchr(inname,'.')), exti[NUMOPT-1] ) )
+                  lst = -1;
+	    
+            if (lst == 1 || lst == -1) fn = read_lst(inname,lst);
+	    else if (lst == 0 || lst == 2)
+	    {
+		flg = -1;
+		if (lst == 0)
+		{
+    	    	    printf("Type %s filename inc. extension (eg %s):\n",
+                        fmti[md-1],exti[md-1]);
+	    	    get_line(inname, CHLEN);
+		}
+		/*-g option gives the coeffs. for unattended runs*/
+	    	if (! batch)
+		{
+		    printf("Enter up to 3 gainmatching coeffs. (A0 A1 A2):\n");
+		    get_pars(gain,3);
+		}
+	    	printf("A0 = %e, A1 = %e, A2 = %e\n",
+			gain[0], gain[1], gain[2]);
+	    }
+	    if (fn == -1) return 0;
+	    
+	    if (fn == 1 || lst != 1)
+	    {
+		if (gain[1] != 0.0) calib = fabs(1.0/gain[1]);
+		else calib = 1.0;
+	    	printf("You can choose to multiply the coeffs by a"
+	    	    " constant factor (e.g. |1/%.2f| = %.2f).\n"
+                    "Then your keV/channel for the matched spectra will be"
+                    " 1/(factor).\n"
+                    "E.g. for a factor of 2.0 the matched spectra will have 0.5 keV/channel\n"
+		    "Enter value for factor [<Enter> for 1.0]\n",gain[1],calib);
+	    	if (batch) calib = 1.0;
+	    	else get_val(&calib);
+	    	if (calib <= 0.0)
+	    	{
+	    	    printf("Mult. factor = 0.0 ==> reset to 1.0\n");
+	    	    calib = 1.0;
+	    	}
+	    }
+	    /*zero spectra arrays*/	    	
+    	    for (i = 0; i < CHMAX; i++)
+	    {
+		spectrum[i] = 0.0;
+		spbuf[i] = 0.0;
+	    }
+    	    					
+	    gain[0] = calib*gain[0];
+	    gain[1] = calib*gain[1];
+	    gain[2] = calib*gain[2];
+	    if (calib != 1.0) printf("A0 = %e, A1 = %e, A2 = %e\n",
+			gain[0], gain[1], gain[2]);
+	    
+    	    /*read spectrum file; a retry needs the coefficients of the entry*/
+	    if ( (numch = read_spec(inname, md)) < 0)
+            {
+                sprintf(outname, "%s %g %g %g", inname, gain[0]/calib,
+                        gain[1]/calib, gain[2]/calib);
+                fail_note(outname, "cannot read RadWare spectrum");
+                continue;
+            }
+	    
+            /*fill spectrum array; for mostly empty spectra only the
+                nonzero channels are moved*/
+	    if (sp_pack(numch) < numch/SPOCC)
+	        rebin_map(spectrum, spbuf, numch, numch, gain, sparse.ch, sparse.n);
+	    else rebin_map(spectrum, spbuf, numch, numch, gain, NULL, 0);
+	    
+	    /*round counts in spectrum array*/
+    	    for (j = 0; j < numch; j++)   	    	
+ 	    	spectrum[j] = (float)( (int)(spbuf[j] + 0.5) );
+	    /*matched spectra have 1/(factor) keV/channel*/
+	    meta.cal[0] = meta.cal[2] = 0.0;
+	    meta.cal[1] = 1.0/calib;
+
+	    strcpy(outname,inname);
+    	    set_ext(outname, ext[md-1]);
+    	    /*check file status*/
+    	    if (file_status(outname, ext[md-1], CHLEN) < 0) continue;
+    	    
+    	    printf(" %s", inname);
+	    write_spec(outname, numch, md);
+    	}
+    } /* END Gainmatch RadWare spectrum and output as RadWare */
+                     
+    return 0;
+} /*END main()*/
+
+/*==========================================================================*/
+/* ar_expr: evaluate sums (lvl 0), products (lvl 1) or a factor (lvl 2) of  */
+/*          an arithmetic expression at *p into r, return 0 or -1           */
+/****************************************************************************/
+int ar_expr(char **p, int lvl, struct arval *r, int n)
+{
+    extern float spectrum[CHMAX];
+    struct  arval b;
+    char    op, fn[CHLEN], *q;
+    int     i, lr, m, rb;
+    
+    r->y = r->v = NULL;
+    r->k = 0.0;
+    while (isspace(**p)) (*p)++;
+    
+    if (lvl < 2)
+    {
+        if (ar_expr(p, lvl + 1, r, n) < 0) return -1;
+        while (1)
+        {
+            while (isspace(**p)) (*p)++;
+            op = **p;
+            if ( (lvl == 0 && op != '+' && op != '-')
+                || (lvl == 1 && op != '*' && op != '/') ) return 0;
+            (*p)++;
+            if (ar_expr(p, lvl + 1, &b, n) < 0 || ar_op(r, &b, op, n) < 0)
+            {
+                free(r->y);
+                r->y = NULL;
+                return -1;
+            }
+        }
+    }
+    
+    /*factor: -factor, (expr), number, live(s) or real(s), x or [file]*/
+    if (**p == '-')
+    {
+        (*p)++;
+        if (ar_expr(p, 2, r, n) < 0) return -1;
+        r->k = -r->k;
+        if (r->y != NULL) for (i = 0; i < n; i++) r->y[i] = -r->y[i];
+        return 0;
+    }
+    if (**p == '(')
+    {
+        (*p)++;
+        if (ar_expr(p, 0, r, n) < 0) return -1;
+        while (isspace(**p)) (*p)++;
+        if (**p == ')')
+        {
+            (*p)++;
+            return 0;
+        }
+        printf("\nMissing ) in expression at: %s\n", *p);
+        free(r->y);
+        r->y = NULL;
+        return -1;
+    }
+    if (isdigit(**p) || **p == '.')
+    {
+        r->k = (float)strtod(*p, &q);
+        if (q == *p)
+        {
+            printf("\nBad number in expression at: %s\n", *p);
+            return -1;
+        }
+        *p = q;
+        return 0;
+    }
+    lr = 0;
+    if (! strncmp(*p, "live(", 5)) lr = 1;
+    else if (! strncmp(*p, "real(", 5)) lr = 2;
+    if (lr) *p += 5;
+    while (isspace(**p)) (*p)++;
+    
+    /*spectrum: x is the one being converted, others are read once*/
+    i = -1;
+    if (**p == 'x' && ! isalnum((*p)[1]) && (*p)[1] != '_') (*p)++;
+    else if (**p == '[' && (q = strchr(*p, ']')) != NULL && q - *p < CHLEN)
+    {
+        strncpy(fn, *p + 1, q - *p - 1);
+        fn[q - *p - 1] = '\0';
+        *p = q + 1;
+        if ( (i = ar_load(fn)) < 0) return -1;
+    }
+    else
+    {
+        printf("\nUnknown term in expression at: %s\n", *p);
+        return -1;
+    }
+    
+    if (lr)
+    {
+        while (isspace(**p)) (*p)++;
+        if (**p != ')')
+        {
+            printf("\nMissing ) in expression at: %s\n", *p);
+            return -1;
+        }
+        (*p)++;
+        if (lr == 1) r->k = i < 0 ? meta.live : arcache.live[i];
+        else r->k = i < 0 ? meta.real : arcache.real[i];
+        if (r->k <= 0.0)
+        {
+            printf("\n%s time of %s is not known\n", lr == 1 ? "Live" : "Real",
+                    i < 0 ? "x" : arcache.name[i]);
+            return -1;
+        }
+        return 0;
+    }
+    
+    /*counts have Poisson variances; other files are rebinned as x was,
+        straight into r->y (so room for CHMAX channels) rather than through
+        a buffer on the stack of every level of the expression*/
+    rb = (i >= 0 && (rbfac > 1 || rbg[1] != 0.0));
+    m = rb ? CHMAX : n;
+    if ( (r->y = (float *) malloc( (m + n)*sizeof(float) )) == NULL) return -1;
+    r->v = r->y + m;
+    if (i >= 0)
+    {
+        if (rb) lr = rebin(arcache.y[i], r->y, arcache.numch[i]);
+        else for (lr = 0; lr < n && lr < arcache.numch[i]; lr++)
+            r->y[lr] = arcache.y[i][lr];
+        for (; lr < n; lr++) r->y[lr] = 0.0;
+    }
+    else memcpy(r->y, spectrum, n*sizeof(float));
+    for (lr = 0; lr < n; lr++) r->v[lr] = r->y[lr] > 0.0 ? r->y[lr] : 0.0;
+    return 0;
+} /*END ar_expr()*/
+
+/*==========================================================================*/
+/* ar_load: read spectrum file name of an expression once, return its slot */
+/****************************************************************************/
+int ar_load(char name[])
+{
+    extern float spectrum[CHMAX];
+    struct  specmeta m;
+    float   *sp;
+    int     i, numch;
+    
+    for (i = 0; i < arcache.n; i++)
+        if (! strcmp(arcache.name[i], name)) return i;
+    if (arcache.n == NARF)
+    {
+        printf("\nMax. %d spectrum files in an expression\n", NARF);
+        return -1;
+    }
+    
+    /*the spectrum being converted and its metadata are kept*/
+    if ( (sp = (float *) malloc(CHMAX*sizeof(float))) == NULL) return -1;
+    memcpy(sp, spectrum, CHMAX*sizeof(float));
+    m = meta;
+    printf("\n");
+    numch = read_any(name);
+    i = arcache.n;
+    if (numch > 0 && (arcache.y[i] = (float *) malloc(numch*sizeof(float))))
+    {
+        strcpy(arcache.name[i], name);
+        arcache.numch[i] = numch;
+        arcache.live[i] = meta.live;
+        arcache.real[i] = meta.real;
+        memcpy(arcache.y[i], spectrum, numch*sizeof(float));
+        arcache.n++;
+    }
+    else
+    {
+        printf("%s***Cannot read %s of the expression%s\n",clr[1],name,clr[0]);
+        i = -1;
+    }
+    memcpy(spectrum, sp, CHMAX*sizeof(float));
+    free(sp);
+    meta = m;
+    return i;
+} /*END ar_load()*/
+
+/*==========================================================================*/
+/* ar_op: a = a op b for spectra and/or constants, propagating variances.   */
+/*        b is freed                                                        */
+/****************************************************************************/
+int ar_op(struct arval *a, struct arval *b, char op, int n)
+{
+    float   *y, *v, *yb, *vb, k, r;
+    int     i;
+    
+    if (b->y == NULL && (op == '/') && b->k == 0.0)
+    {
+        printf("\nDivision by zero in expression\n");
+        return -1;
+    }
+    /*constant op constant*/
+    if (a->y == NULL && b->y == NULL)
+    {
+        if (op == '+') a->k += b->k;
+        else if (op == '-') a->k -= b->k;
+        else if (op == '*') a->k *= b->k;
+        else a->k /= b->k;
+        return 0;
+    }
+    
+    /*spectrum op constant, or constant op spectrum*/
+    if (a->y == NULL || b->y == NULL)
+    {
+        k = a->y == NULL ? a->k : b->k;
+        if (a->y == NULL)
+        {
+            a->y = b->y;
+            a->v = b->v;
+            b->y = NULL;
+            /*k - y and k/y: reverse the order*/
+            if (op == '-')
+            {
+                for (i = 0, y = a->y; i < n; i++) y[i] = k - y[i];
+                return 0;
+            }
+            if (op == '/')
+            {
+                for (i = 0, y = a->y, v = a->v; i < n; i++)
+                {
+                    r = y[i] != 0.0 ? k/y[i] : 0.0;
+                    v[i] = y[i] != 0.0 ? r*r*v[i]/(y[i]*y[i]) : 0.0;
+                    y[i] = r;
+                }
+                return 0;
+            }
+        }
+        y = a->y;
+        v = a->v;
+        if (op == '+') for (i = 0; i < n; i++) y[i] += k;
+        else if (op == '-') for (i = 0; i < n; i++) y[i] -= k;
+        else
+        {
+            if (op == '/') k = 1.0/k;
+            for (i = 0; i < n; i++)
+            {
+                y[i] *= k;
+                v[i] *= k*k;
+            }
+        }
+        return 0;
+    }
+    
+    /*spectrum op spectrum*/
+    y = a->y;
+    v = a->v;
+    yb = b->y;
+    vb = b->v;
+    if (op == '+') for (i = 0; i < n; i++)
+    {
+        y[i] += yb[i];
+        v[i] += vb[i];
+    }
+    else if (op == '-') for (i = 0; i < n; i++)
+    {
+        y[i] -= yb[i];
+        v[i] += vb[i];
+    }
+    else if (op == '*') for (i = 0; i < n; i++)
+    {
+        v[i] = yb[i]*yb[i]*v[i] + y[i]*y[i]*vb[i];
+        y[i] *= yb[i];
+    }
+    else for (i = 0; i < n; i++)
+    {
+        r = yb[i] != 0.0 ? y[i]/yb[i] : 0.0;
+        v[i] = yb[i] != 0.0 ? (v[i] + r*r*vb[i])/(yb[i]*yb[i]) : 0.0;
+        y[i] = r;
+    }
+    free(b->y);
+    b->y = NULL;
+    return 0;
+} /*END ar_op()*/
+
+/*==========================================================================*/
+/* ar_stage: replace spectrum[] by the -A expression, writing the errors    */
+/*           as "name_err" with -E. Returns -1 (nothing to write) on error  */
+/****************************************************************************/
+int ar_stage(char name[], int numch, int md, int of)
+{
+    extern float spectrum[CHMAX];
+    struct  arval r;
+    char    errname[CHLEN], *ex, *p = aropt;
+    int     i;
+    
+    if (numch <= 0 || numch > CHMAX) return -1;
+    if (ar_expr(&p, 0, &r, numch) < 0) return -1;
+    while (isspace(*p)) p++;
+    if (*p != '\0' || r.y == NULL)
+    {
+        printf("\n%s***Expression %s does not give a spectrum%s\n",
+                clr[1],aropt,clr[0]);
+        free(r.y);
+        return -1;
+    }
+    memcpy(spectrum, r.y, numch*sizeof(float));
+    
+    if (arerr && strlen(name) + 4 < CHLEN)
+    {
+        strcpy(errname, name);
+        ex = strrchr(errname,'.');
+        if (ex && (! strrchr(errname,'/') || ex > strrchr(errname,'/')))
+            *ex = '\0';
+        strcat(errname, "_err");
+        if ( (ex = strrchr(name,'.'))
+            && (! strrchr(name,'/') || ex > strrchr(name,'/')) )
+            strcat(errname, ex);
+        for (i = 0; i < numch; i++) spectrum[i] = sqrtf(r.v[i]);
+        printf(" errors");
+        if (md > 0) write_spec(errname, numch, md);
+        else write_ofmt(errname, numch, of);
+        memcpy(spectrum, r.y, numch*sizeof(float));
+    }
+    free(r.y);
+    return 0;
+} /*END ar_stage()*/
+
+/*==========================================================================*/
+/* ascii_read: read an ASCII format spectrum	    	    	    	    */
+/****************************************************************************/
+int ascii_read(char name[])
+{
+    float   rd = 0;
+    int     ascii = 0, chan = 0, res = 0, lchan = CHMAX;
+    FILE    *fsp;
+     
+    /*opens ascii file*/
+    if ((fsp = spec_open(name, "r" )) == NULL)
+    {
+    	printf("Cannot open file: %s \n", name);
+    	return -1;
+    }
+    
+    /*Determine if spectrum is 1 or 2 col. ascii format & set 1 col flag*/
+    if ( (ascii = col_determ(fsp)) == 0)
+    {
+	printf("%s***No suitable data in file %s; Exiting...%s\n\n",
+                clr[1],name,clr[0]);
+	spec_close(fsp);
+	return -1;
+    }  
+    printf("Ascii %d column format....", ascii);    
+    /*End of deciding if spectrum is 1 or 2 column ascii format*/
+    
+    for (chan = 0; chan < CHMAX; chan++)
+    { 
+/*    	res = fscanf(fsp, "%f %f", &rd, &spectrum[chan]); */
+	if (ascii == 2)    /*only for two column data*/
+	{
+    	    res = fscanf(fsp, "%f", &rd);
+	    chan = (int) rd;
+	}
+    	res = fscanf(fsp, "%f\n", &spectrum[chan]);
+	switch (res)
+	{
+	    case 0:
+	    {
+	    	printf("\nchan= %d, spec[chan]= %f\n", chan,
+		    	spectrum[chan]);
+    	    	printf("Read error occurred for file: %s\n", name);
+                /*close ascii file*/
+	    	spec_close(fsp);
+	    	return -1;
+	    }
+	    case EOF:
+	    {
+	    	if (chan < CHMAX)
+		{
+		    /*increment chan because chan starts from zero. This is
+		    because of line: chan = (int) rd;*/
+		    if (ascii == 2) chan += 1;
+	    	    printf("Reached EOF after reading chan %d \n", chan);
+		    if (chan == 0)
+		    {
+			printf("\n*******Incorrect file format*******\n");
+			printf("....Exiting....\n\n");
+			spec_close(fsp);
+			return -1;
+		    }
+		}
+		lchan = chan;
+                /*now set chan = CHMAX to exit for() loop*/
+	    	chan = CHMAX;
+    	    	break;
+	    }
+	    default:
+	    {
+/*	    	if (chan == 0) printf("Reading ascii spectrum.......\n");*/
+	    	break;
+    	    }
+    	}
+    }
+    chan = lchan;
+    
+    spec_close(fsp); 
+    return (chan);
+} /*END ascii_read()*/
+
+/*==========================================================================*/
+/* ascii_write: write an ASCII format spectrum	    	    	    	    */
+/****************************************************************************/
+void ascii_write(char name[], int numch)
+{
+    int j;
+    FILE *fasc;
+    /*open .txt file*/
+    if ( (fasc = spec_open(name, "w" )) == NULL)
+    {
+        printf("Cannot open file: %s \n", name);
+        return ; 
+    }
+   
+    /*write .txt file using floats*/
+    for (j = (whi >= 0 && rbfac < 2 && rbg[1] == 0.0 ? wlo : 0); j < numch; j++)
+        fprintf(fasc, "%d %.5f\n", j, spectrum[j]);
+    
+    printf(" ==> %s %d chs.\n", name, numch);
+
+    spec_close(fasc);
+} /*END ascii_write()*/
+
+/*==========================================================================*/
+/* bg_stage: subtract the SNIP background from spectrum[] before writing,   */
+/*           first writing the background itself as "name_bg" with -K      */
+/****************************************************************************/
+int bg_stage(char name[], int numch, int md, int of)
+{
+    float   bg[CHMAX], y[CHMAX];
+    char    bgname[CHLEN], *ex;
+    int     i;
+    
+    if (numch <= 0 || numch > CHMAX) return -1;
+    snip_bg(spectrum, bg, numch, bgit, bgwin, bglls);
+    
+    if (bgout && strlen(name) + 3 < CHLEN)
+    {
+        strcpy(bgname, name);
+        ex = strrchr(bgname,'.');
+        if (ex && (! strrchr(bgname,'/') || ex > strrchr(bgname,'/')))
+            *ex = '\0';
+        strcat(bgname, "_bg");
+        if ( (ex = strrchr(name,'.'))
+            && (! strrchr(name,'/') || ex > strrchr(name,'/')) )
+            strcat(bgname, ex);
+        /*same writer (stages are not run again)*/
+        memcpy(y, spectrum, numch*sizeof(float));
+        memcpy(spectrum, bg, numch*sizeof(float));
+        printf(" background");
+        if (md > 0) write_spec(bgname, numch, md);
+        else write_ofmt(bgname, numch, of);
+        memcpy(spectrum, y, numch*sizeof(float));
+    }
+    
+    for (i = 0; i < numch; i++) spectrum[i] -= bg[i];
+    return 0;
+} /*END bg_stage()*/
+
+/*==========================================================================*/
+/*Puts spectrum length in filename before ext 	    	    	    	    */
+/****************************************************************************/
+void chan_num_ext(char fin[], char fout[], int *numch, char ext[])
+{
+    float tmpf = 0.0;
+    int force = 0, i;
+    char buf[20];
+    char ans[20];
+
+    strcpy(fout,fin);
+    set_ext(fout, ext);
+    
+    if ( ! batch && ( ( (*numch) < 2048) || ( ((*numch))%1024 != 0) ) )
+    {
+    	while (force == 0)
+    	{
+    	    printf("Would you like to force the length of the"
+    		" spectrum (y/n)?\n");
+	    get_ans(ans,1);
+    	    if (ans[0] == 'y' || ans[0] == 'Y')
+    	    {
+    		printf("Enter length in channels (max.%d) eg 8192\n"
+    		"(Enter only multiples of 1024 channels)\n",CHMAX);
+    		get_val(&tmpf);
+		*numch = (int)tmpf;
+    		if ( (*numch%1024 == 0) &&  (*numch < CHMAX) )
+    		{
+    		    force = 1;
+    		    break;
+    		}
+    		else printf("Length entered is not a multiple of 1024"
+    			" or >%d\n",CHMAX);
+    	    }
+    	    else if (ans[0] == 'n' || ans[0] == 'N')
+    	    {
+    		force = 1;
+    		break;
+    	    }
+    	}
+    }
+    /*If not an xtrack spectrum, return current filename*/
+    /*enters if statement if equal to NULL..strcmp returns zero if identical*/
+    if ( strcmp(ext,".spec") )
+	return ;
+    
+    /*if it is an xtrack spectrum, construct new file extension*/
+    i = 0;
+    itoa(*numch, buf);
+    strncpy(ans+i++, "_", 1);
+    strncpy(ans+i++, buf, 1);
+    if (*numch >= 10000) strncpy(ans+i++, buf+1, 1 );
+    if (*numch < 1000)
+    {
+    	strncpy(ans+i++, buf+1, 1 );
+	strncpy(ans+i++, buf+2, 1 );
+    }
+    else strncpy(ans+i++, "k", 1 );
+    strcpy(ans+i++, ext );
+    strcpy( strrchr(fout, '.'), ans );
+    return ;
+} /*END chan_num_ext()*/
+
+/*==========================================================================*/
+/*check_ext: check file extension is ext 	    	    	    	    	    	    */
+/****************************************************************************/
+void check_ext(char fin[], char ext[])
+{
+    char ans[3];
+    
+    /*strcmp returns zero if identical, i.e. if not equal to NULL*/
+    if ( strrchr(fin,'.') && ! strcmp( (strrchr(fin,'.')), ext ) ) return ;
+    /*no questions when running unattended*/
+    if (batch) return ;
+    else
+    {	
+	while (1)
+	{
+    	    printf("File extension is not '%s'\n"
+		    "Are you sure this is the correct filename (y/n) ?\n",ext);    	    	      /*no ext found*/
+	    get_ans(ans,1);
+	    if (ans[0] == 'y' || ans[0] == 'Y') return ;
+	    else if (ans[0] == 'n' || ans[0] == 'N')
+	    {
+	    	printf("Enter new file name inc. extension (%s):\n",ext);
+	    	get_line(fin, CHLEN);
+  	    	printf("New filename is: %s \n",fin);
+	    	return ;
+	    }
+	}
+    }
+} /*END check_ext()*/
+
+/*==========================================================================*/
+/* chn_write: write a Maestro .Chn spectrum (header, int counts, trailer)   */
+/*            in a single write, times, date and calibration from meta     */
+/****************************************************************************/
+void chn_write(char name[], int numch)
+{
+    static char mon[12][4] = {"JAN","FEB","MAR","APR","MAY","JUN",
+                              "JUL","AUG","SEP","OCT","NOV","DEC"};
+    struct  maest_header *h;
+    struct  maest_trailer *t;
+    int     i, y, mo, d, hms[3], *cnt, off;
+    long    len;
+    char    *buf, dt[12];
+    FILE    *fsp;
+    
+    /*data from the window start (as ascii_write()) or the first channel
+        of the spectrum read, if there are no counts below it*/
+    off = whi >= 0 && rbfac < 2 && rbg[1] == 0.0 ? wlo : meta.off;
+    if (off < 0 || off >= numch) off = 0;
+    for (i = 0; i < off && spectrum[i] == 0.0; i++) ;
+    if (i < off) off = 0;
+    
+    /*the channel count is a short: drop trailing empty channels only*/
+    for (i = numch; i - off > 32767 && spectrum[i-1] == 0.0; i--) ;
+    if (i - off > 32767)
+    {
+        printf("%s***%s: %d channels, max. 32767 for .Chn (compress with -c)%s\n",
+                clr[1],name,numch - off,clr[0]);
+        return ;
+    }
+    numch = i - off;
+    len = sizeof(*h) + numch*sizeof(int) + sizeof(*t);
+    if ( (buf = (char *) calloc(len, 1)) == NULL)
+    {
+        printf("Cannot allocate memory for %s \n", name);
+        return ;
+    }
+    h = (struct maest_header *) buf;
+    cnt = (int *) (buf + sizeof(*h));
+    t = (struct maest_trailer *) (buf + len - sizeof(*t));
+    
+    /*header: type -1, MCA 1, segment 1, times in 20 ms ticks*/
+    h->q1 = -1;
+    h->q2 = 1;
+    h->q3 = 1;
+    h->real = meta.real > 0.0 ? (unsigned int)(meta.real/0.02 + 0.5) : 0;
+    h->lve = meta.live > 0.0 ? (unsigned int)(meta.live/0.02 + 0.5) : 0;
+    h->off = off;
+    h->channels = numch;
+    /*DDMMMYY then '1' after 2000, HHMM, the seconds as ASCII in q4*/
+    if (meta_date(&y, &mo, &d, hms) == 0)
+    {
+        snprintf(dt, sizeof(dt), "%02d%s%02d%c", d, mon[mo-1], y%100,
+                y >= 2000 ? '1' : '0');
+        memcpy(h->dt, dt, 8);
+        snprintf(dt, sizeof(dt), "%02d%02d%02d", hms[0], hms[1], hms[2]);
+        memcpy(h->sttm, dt, 4);
+        memcpy(&h->q4, dt+4, 2);
+    }
+    else memset(h->dt, ' ', 8);
+    
+    /*counts are integers*/
+    for (i = 0; i < numch; i++) cnt[i] = spectrum[off + i] > 0.0
+            ? (int)(spectrum[off + i] + 0.5) : 0;
+    
+    /*trailer: type -102 and the energy calibration*/
+    t->t1 = -102;
+    memcpy(t->g, meta.cal, sizeof(t->g));
+    
+    if ( (fsp = spec_open(name, "w" )) == NULL)
+    {
+        printf("Cannot open file: %s \n", name);
+        free(buf);
+        return ; 
+    }
+    if (fwrite(buf, len, 1, fsp) != 1)
+        printf("Error writing to file: %s \n", name);
+    else printf(" ==> %s %d chs.\n", name, numch);
+    spec_close(fsp);
+    free(buf);
+} /*END chn_write()*/
+
+/*==========================================================================*/
+/* col_determ: find if a file has 1 or 2 column format      	    	    */
+/****************************************************************************/
+int col_determ(FILE *file)
+{
+    int     col = 0, hash = 0, blnk = 0;
+    fpos_t  pos;
+    
+    /*skip comment lines starting with #*/
+    skip_hash(file);
+    
+    /*store current file position in pos*/
+    fgetpos(file, &pos);
+     	   
+    while (1)
+    {
+    	/*read until first digit of first number*/
+    	while ( isdigit(hash = fgetc(file)) == 0 ) ;
+    	
+	col = 1;
+        /*found first digit of first number. read rest of digits*/
+    	/*ignore decimal points*/
+    	while ( (isdigit(hash = fgetc(file)) != 0) || (hash == '.') ) ;
+    	
+        /*push the last character back on the stream*/
+    	ungetc(hash, file);
+    	/*now test characters until end of line*/
+    	while ( (hash = fgetc(file)) != '\n' )
+    	{
+    	    /*if blank space,increment blank counter and continue*/
+    	    if ( (hash == ' ') || (hash == '\t') || (hash == '\r')) blnk++;
+    	    /*check how many columns of numbers are present*/
+            else if ( (isdigit(hash)) == 0 )
+            {
+                printf("%s***Input is not a valid data file."
+                        " Illegal characters found.%s\n",clr[1],clr[0]);
+                col = 0;
+                return 0;
+            }
+    	    /*if character is a digit*/
+    	    /*check how many columns of numbers are present*/
+    	    else if ( (isdigit(hash)) != 0 )
+    	    {
+    		/*if number increment col flag*/
+    		if (blnk > 0) col++;
+    		
+   		/*otherwise if > MAXCOLS columns set 1 col. flag
+                    and hope for best*/
+    		if ( (blnk != 0) && (col > MAXCOLS) )
+    		{
+    		    col = 1;
+    		    break;
+    		}
+    		/*reset blank counter to zero*/
+    		blnk = 0;
+    		/*read rest of digits*/
+    		while ( (isdigit(hash = fgetc(file)) != 0) || (hash == '.') ) ;
+    		
+                /*push the last character back on the stream*/
+    		ungetc(hash, file);
+    	    }
+    	}
+    	break;
+    }
+    /*reset file position to start of data*/
+    fsetpos(file, &pos);
+    return col;
+} /*END col_determ()*/
+
+/*==========================================================================*/
+/*convert_bytes: convert bytes into Kb, Mb, etc     	    	    	    */
+/****************************************************************************/
+long convert_bytes(char name[])
+{
+    float sz;
+    int i;
+    char bye[4][2];
+    struct stat stbuf;
+    
+    for (i = 0; i < 3; i++)
+    {
+	bye[i][0] = (char)0;
+	bye[i][1] = (char)0;
+    }
+    strncpy(bye[0],"b",2);
+    strncpy(bye[1],"Kb",2);
+    strncpy(bye[2],"Mb",2);
+    strncpy(bye[3],"Gb",2);
+    
+    stat(name, &stbuf);
+    sz = (float)stbuf.st_size;
+    i = 0;
+    while ( sz >= 1024.0 )
+    {
+	sz /= 1024;
+	i++;
+    }
+    printf("\n File size: %ld bytes (%.1f %c%c)\n",
+	    (long)stbuf.st_size,sz,bye[i][0],bye[i][1]);
+    return (long)stbuf.st_size;
+} /*END convert_bytes()*/
+
+/*==========================================================================*/
+/* cswap2: swap bits of a 2 byte number     	    	    	    	    */
+/****************************************************************************/
+int cswap2(int decim)
+{
+    int i, j, max = 17;
+    char bin[17];
+    int swapped = 0;
+    
+    for (i = 1; i >= 0; --i)
+    {
+	for (j = 0; j < (max-1)/2; ++j)
+	{
+    	    if (decim & 0x8000) bin[i*8+j] = '1';
+	    else bin[i*8+j] = '0';
+	    
+	    decim <<= 1;
+/*	    printf(" i*8+j = %d \n", i*8+j); */
+	}
+    }
+    bin[max-1] = '\0';
+/*    printf("bin = %s \n", bin); */
+    for (i = 0; i < max-1; ++i)
+    {
+	if (bin[max-2-i] == '1')
+	{
+	    swapped = swapped + (int)pow( (double)2, (double)(i));
+	}
+    }
+    
+    return swapped;
+} /*END cswap2()*/
+
+/*==========================================================================*/
+/* cswap4: swap bits of a 4 byte number	    	    	    	    	    */
+/****************************************************************************/
+int cswap4(int decim)
+{
+    int i, j, max = 33;
+    char bin[33];
+    int swapped = 0;
+    
+    for (i = 3; i >= 0; --i)
+    {
+	for (j = 0; j < (max-1)/4; ++j)
+	{
+    	    if (decim & 0x80000000) bin[i*8+j] = '1';
+	    else bin[i*8+j] = '0';
+	    
+	    decim <<= 1;
+/*	    printf(" i*8+j = %d \n", i*8+j); */
+	}
+    }
+    bin[max-1] = '\0';
+/*    printf("bin = %s \n", bin); */
+    for (i = 0; i < max-1; ++i)
+    {
+	if (bin[max-2-i] == '1')
+	    swapped = swapped + (int)pow( (double)2, (double)(i));
+    }
+    
+    return swapped;
+} /*END cswap()*/
+
+/*==========================================================================*/
+/* csv_num: write v as a CSV field to out, empty if it is not a number;     */
+/*          return its length                                               */
+/****************************************************************************/
+int csv_num(char out[], double v)
+{
+    if (! isfinite(v))
+    {
+        out[0] = '\0';
+        return 0;
+    }
+    return sprintf(out, "%g", v);
+} /*END csv_num()*/
+
+/*==========================================================================*/
+/* csv_str: write s as a CSV field to out, quoted with doubled quotes if it */
+/*          holds a comma, quote or line break; return its length, at most */
+/*          2*strlen(s) + 2                                                 */
+/****************************************************************************/
+int csv_str(char out[], char s[])
+{
+    int     i, k = 0;
+    
+    if (strpbrk(s, ",\"\r\n") == NULL) return sprintf(out, "%s", s);
+    out[k++] = '"';
+    for (i = 0; s[i]; i++)
+    {
+        if (s[i] == '"') out[k++] = '"';
+        out[k++] = s[i];
+    }
+    out[k++] = '"';
+    out[k] = '\0';
+    return k;
+} /*END csv_str()*/
+
+/*==========================================================================*/
+/* decode_mspec_name: decode multiple spectrum filename     	    	    */
+/****************************************************************************/
+void decode_mspec_name(char name[], int *set, int *mxsp, int *numch,
+	int *sz, int bytes)
+{
+    float   pars[4];
+    int i, j;
+    char ans[80] = "", ans0[10];
+    
+    i = (strrchr(name,'_') - 1) - (strchr(name,'_') + 2);
+    memset(ans,'\0',sizeof(ans));
+    strncpy(ans,strchr(name,'_')+2, i);
+
+    /*read string BACKWARDS since at start is an optional
+     	multiple spectra set indicator*/
+
+    i--; j = 0;
+    /*read letter(s) at end*/
+    memset(ans0,'\0',sizeof(ans0));
+    while ( isalpha(ans[i]) ) ans0[j++] = ans[i--];
+    reverse(ans0);
+    if (!strncmp(ans0, "UI", j) || !strncmp(ans0, "ui", j))
+	*sz = (int)sizeof(unsigned int);
+    else if (!strncmp(ans0, "I", j) || !strncmp(ans0, "i", j))
+	*sz = (int)sizeof(unsigned int);
+    else if (!strncmp(ans0, "S", j) || !strncmp(ans0, "s", j))
+	*sz = (int)sizeof(short int);
+    else if (!strncmp(ans0, "US", j) || !strncmp(ans0, "us", j))
+	*sz = (int)sizeof(short int);
+    else if (!strncmp(ans0, "F", j) || !strncmp(ans0, "f", j))
+    	*sz = (int)sizeof(float);
+
+    /*read number of channels*/
+    while (! isdigit(ans[i]) ) i--;
+    j = 0;
+    memset(ans0,'\0',sizeof(ans0));
+    while ( isdigit(ans[i]) ) ans0[j++] = ans[i--];
+    reverse(ans0);
+    *numch = atoi(ans0);
+    
+    /*read number of spectra*/
+    while (! isdigit(ans[i]) ) i--;
+    j = 0;
+    memset(ans0,'\0',sizeof(ans0));
+    while ( isdigit(ans[i]) ) ans0[j++] = ans[i--];
+    reverse(ans0);
+    *mxsp = atoi(ans0);
+    
+    /*check for optional multiple spectra set indicator*/
+    if (i > 0)
+    {
+	while (! isdigit(ans[i]) ) i--;
+    	j = 0;
+    	memset(ans0,'\0',sizeof(ans0));
+    	while ( isdigit(ans[i]) ) ans0[j++] = ans[i--];
+    	reverse(ans0);
+    	*set = atoi(ans0);
+    }
+    
+    if ((*set)*(*sz)*(*mxsp)*(*numch) != bytes && batch)
+    {
+	printf("Spectra details in filename do not match file size\n");
+	*mxsp = 0;
+	return ;
+    }
+    if ((*set)*(*sz)*(*mxsp)*(*numch) != bytes)
+    {
+	printf("Enter spectra details: set(s) of spectra, no. of spectra,"
+		" channels, bytes/chan.\n   (set, mxsp, numch, sz)\n");
+    	get_pars(pars,4);
+	*set = (int)pars[0];
+	*mxsp = (int)pars[1];
+    	*numch = (int)pars[2];
+	*sz = (int)pars[3];
+	if ((*set)*(*sz)*(*mxsp)*(*numch) != bytes)
+	{
+	    *numch = 0;
+	    return ;
+	}
+    }
+    
+    if ((*set)*(*sz)*(*mxsp)*(*numch) == bytes)
+	printf("Found %d sets of %d spectra: %d channels"
+	    " (%d bytes/channel)\n",*set,*mxsp,*numch,*sz);
+    
+    *mxsp *= *set;
+    return ;
+} /*END decode_mspec_name()*/
+
+/*==========================================================================*/
+/* fail_done: close the failure report, keeping it only if entries failed,  */
+/*            return the exit status: rc if it is an error, else 1 if      */
+/*            entries failed and 0 if not                                   */
+/****************************************************************************/
+int fail_done(int rc)
+{
+    char    tmp[CHLEN+8];
+    
+    if (failfd >= 0)
+    {
+        close(failfd);
+        failfd = -1;
+        sprintf(tmp, "%s.tmp", failname);
+        /*a clean run (e.g. the retry) removes an old report*/
+        if (nfail > 0 && rename(tmp, failname) == 0)
+            printf("%s***%d failed entries ==> %s (convert it to retry them)%s\n",
+                    clr[1],nfail,failname,clr[0]);
+        else
+        {
+            unlink(tmp);
+            unlink(failname);
+        }
+    }
+    else if (nfail > 0)
+        printf("%s***%d entries could not be converted%s\n",clr[1],nfail,clr[0]);
+    if (rc < 0) return rc;
+    return nfail > 0 ? 1 : 0;
+} /*END fail_done()*/
+
+/*==========================================================================*/
+/* fail_note: count a failed entry (name and any options) and report it    */
+/****************************************************************************/
+void fail_note(char entry[], char why[])
+{
+    nfail++;
+    fail_report(entry, why);
+} /*END fail_note()*/
+
+/*==========================================================================*/
+/* fail_open: start the failure report of list file list, list.fail or the  */
+/*            -F name, written as name.tmp until the run has finished       */
+/****************************************************************************/
+int fail_open(char list[])
+{
+    char    tmp[CHLEN+32];
+    
+    if (failfd >= 0) return 0;
+    if (strlen(failopt)) strcpy(failname, failopt);
+    else list_side(failname, list, ".fail");
+    sprintf(tmp, "%s.tmp", failname);
+    if ( (failfd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0666)) < 0)
+    {
+        printf("Cannot open file: %s \n", tmp);
+        return -1;
+    }
+    sprintf(tmp, "# failed entries of %s\n", list);
+    if (write(failfd, tmp, strlen(tmp)) < 0) ;
+    return 0;
+} /*END fail_open()*/
+
+/*==========================================================================*/
+/* fail_report: report a failed entry and the reason, as a comment line and */
+/*              the entry in the failure report, without counting it        */
+/****************************************************************************/
+void fail_report(char entry[], char why[])
+{
+    char    ln[2*CHLEN+8];
+    int     n;
+    
+    printf("%s***%s: %s ...skipped%s\n",clr[1],why,entry,clr[0]);
+    /*one write per entry so that concurrent workers do not mix lines*/
+    if (failfd >= 0)
+    {
+        n = snprintf(ln, sizeof(ln), "# %s\n%s\n", why, entry);
+        if (write(failfd, ln, n < (int)sizeof(ln) ? n : (int)sizeof(ln) - 1) < 0) ;
+    }
+} /*END fail_report()*/
+
+/*==========================================================================*/
+/* file_status: check output file status. 0 (write file), -1 (skip file)   */
+/****************************************************************************/
+int file_status(char name[], char ext[], int len)
+{
+    char    ans[3];
+    struct  stat statbuf;
+    
+    /*unattended: overwrite or skip as chosen at the start*/
+    if (batch && stat(name, &statbuf) == 0)
+    {
+        if (ovwr) return 0;
+    	printf("Output file %s exists ...skipped\n", name);
+        return -1;
+    }
+    while ( (stat(name, &statbuf) == 0) )
+    {
+    	printf("\n*****Output file %s exists. Overwrite (y/n)?\n", name);
+	get_ans(ans,1);
+	if (ans[0] == 'y' || ans[0] == 'Y') break;
+	else if (ans[0] == 'n' || ans[0] == 'N')
+	{
+	    printf("Enter new file name inc. extension (eg %s):\n",ext);
+	    get_line(name, CHLEN);
+    	}
+    }
+    return 0;
+} /*END file_status()*/
+
+/*==========================================================================*/
+/* genie_read: read an GENIE IEC format spectrum	    	    	    	    */
+/****************************************************************************/
+int genie_read(char name[])
+{
+    extern float spectrum[CHMAX];
+    float   v;
+    int     ch, chan = 0, i, l;
+    long    len;
+    char    *buf, *p, *q, *r, *e;
+     
+    /*read the whole file (it is text of 80 character records)*/
+    if ( (buf = load_file(name, &len)) == NULL) return -1;
+    e = buf + len;
+    
+    /*58 header records: 2nd live and real time, 3rd date and time,
+        4th energy calibration coeffs*/
+    for (l = 0, p = buf; l < 58 && p < e; l++, p = q + 1)
+    {
+        if ( (q = memchr(p, '\n', e - p)) == NULL) q = e;
+        if (q - p < 5) continue;
+        r = p + 4;
+        if (l == 1 && scan_num(&r, q, &v) == 0)
+        {
+            meta.live = v;
+            if (scan_num(&r, q, &v) == 0) meta.real = v;
+        }
+        else if (l == 2)
+        {
+            while (r < q && isspace(*r)) r++;
+            for (i = q - r; i > 0 && isspace(r[i-1]); i--) ;
+            printf("Spectrum info: %.*s\n", i < 40 ? i : 40, r);
+            sscanf(r, "%11s %9s", meta.date, meta.time);
+        }
+        else if (l == 3)
+            for (i = 0; i < 3 && scan_num(&r, q, &meta.cal[i]) == 0; i++) ;
+    }
+    strcpy(meta.fmt, "GENIE");
+    if (meta.live >= 0.0 || meta.real >= 0.0)
+        printf("               Real time: %d s\n"
+               "               Live time: %d s\n",(int)meta.real,(int)meta.live);
+    
+    /*data records: id (e.g. A004), first channel and 5 channels of counts*/
+    for ( ; p < e; p = q + 1)
+    {
+        if ( (q = memchr(p, '\n', e - p)) == NULL) q = e;
+        for (r = p; r < q && isspace(*r); r++) ;
+        for ( ; r < q && ! isspace(*r); r++) ;
+        if (scan_num(&r, q, &v) < 0) continue;
+        if ( (ch = (int)v) < 0 || ch >= CHMAX)
+        {
+            printf("Channel %d out of range in file: %s\n", ch, name);
+            break;
+        }
+        for (i = 0; i < 5 && ch + i < CHMAX
+                && scan_num(&r, q, &spectrum[ch + i]) == 0; i++) ;
+        if (ch + i > chan) chan = ch + i;
+    }
+    free(buf);
+    
+    if (chan == 0)
+    {
+        printf("\n*******Incorrect file format*******\n");
+        printf("....Exiting....\n\n");
+        return -1;
+    }
+    printf("Reached EOF after reading chan %d \n", chan);
+    printf("GENIE energy calibration coeffs: %f %f %f\n",
+          meta.cal[0],meta.cal[1],meta.cal[2]);
+    return (chan);
+} /*END genie_read()*/
+
+/*==========================================================================*/
+/* get_ans: get answer without waiting for carriage return   	    	    */
+/****************************************************************************/
+void get_ans(char ans[], int num)
+{
+    int     c = 0, i;
+    struct  termios newt, oldt;
+    
+    while (1)
+    {
+    	tcgetattr(0, &oldt);
+	newt = oldt;
+    	newt.c_lflag &= ~ICANON;
+    	newt.c_cc[VMIN] = 1;
+    	newt.c_cc[VTIME] = 0;
+	/*handle sigs*/
+/*    	newt.c_lflag |= ISIG;*/
+    	tcsetattr(0, TCSANOW, &newt);
+    	i = 0;
+    	while( (c = getchar()) != EOF && (ans[i++] = (char)c) != '\n'
+                && i < 1) ;
+    	
+	tcsetattr(0, TCSANOW, &oldt);
+	if (c == EOF)
+	{
+	    printf("\nEnd of input ...Exiting\n");
+	    exit(-1);
+	}
+    	if (ans[i-1] != '\n') printf("\n");
+	else if (ans[0] == '\n') continue;
+	
+    	ans[i] = '\0';
+    	return ;
+    }
+} /*END get_ans()*/
+
+/*==========================================================================*/
+/* get_entry: read the next name of a list file, with the gainmatching      */
+/*            coefficients after it if g is not NULL; 1 if read, 0 if the   */
+/*            line is not understood, EOF at the end of the file            */
+/****************************************************************************/
+int get_entry(FILE *fp, char name[], float g[])
+{
+    int     i;
+    char    ln[REQMAX], *p, *e, *t, *q;
+    
+    /*the whole line is the name, so names may contain spaces;
+        blank lines and lines starting with # are skipped*/
+    while (fgets(ln, sizeof(ln), fp) != NULL)
+    {
+        for (p = ln; isspace(*p); p++) ;
+        for (e = p + strlen(p); e > p && isspace(e[-1]); e--) ;
+        *e = '\0';
+        if (*p == '\0' || *p == '#') continue;
+        
+        /*coefficients are the last three words of the line*/
+        for (i = 2; g != NULL && i >= 0; i--)
+        {
+            for (t = e; t > p && ! isspace(t[-1]); t--) ;
+            if (t == p) return 0;
+            g[i] = strtod(t, &q);
+            if (q == t || *q != '\0') return 0;
+            for (e = t; e > p && isspace(e[-1]); e--) ;
+            *e = '\0';
+        }
+        strncpy(name, p, CHLEN-1);
+        name[CHLEN-1] = '\0';
+        return 1;
+    }
+    return EOF;
+} /*END get_entry()*/
+
+/*==========================================================================*/
+/* get_line: read a line from stdin into s, return a length    	    	    */
+/****************************************************************************/
+void get_line(char ans[], int len)
+{
+    int     c, i = 0;
+
+    memset(ans,'\0',sizeof(char)*len);
+    /*note that scanf() leaves a carriage return in the keyboard buffer*/
+    while ( (c = getchar()) != '\n' && c != EOF && i < len) ans[i++] = c;
+    
+    ans[i] = '\0';
+} /*END get_line()*/
+
+/*==========================================================================*/
+/* get_line_file: read a line from a file into s, return a length           */
+/****************************************************************************/
+void get_line_file(FILE *file, char ans[], int len)
+{
+    int     c, i = 0;
+
+    memset(ans,'\0',sizeof(char)*len);
+    /*note that scanf() leaves a carriage return in the keyboard buffer*/
+    while ( (c = fgetc(file)) != '\n' && c != EOF && i < len) ans[i++] = c;
+    
+    /*remove any trailing '\r' carriage returns that are often prior to
+      '\n' line feeds*/
+    if (ans[i-1] == '\r') i--;
+    
+    ans[i] = '\0';
+} /*END get_line_file()*/
+
+/*==========================================================================*/
+/* get_mode: get mode from user input	    	    	    	    	    */
+/****************************************************************************/
+int get_mode(int md)
+{
+    char    ans[10] = "";
+    
+    while(1)
+    {
+    	printf(" 1) to convert %s (%s) ==> %s (%s)\n",fmti[0],exti[0],fmt[0],ext[0]);
+    	printf(" 2) to convert %s (%s) ==> %s (%s)\n",fmti[1],exti[1],fmt[1],ext[1]);
+    	printf(" 3) to convert %s (%s) ==> %s (%s)\n",fmti[2],exti[2],fmt[2],ext[2]);
+    	printf(" 4) to convert %s (%s) ==> %s (%s)\n",fmti[3],exti[3],fmt[3],ext[3]);
+    	printf(" 5) to convert %s (%s) ==> %s (%s)\n",fmti[4],exti[4],fmt[4],ext[4]);
+    	printf(" 6) to convert %s (%s) ==> %s (%s)\n",fmti[5],exti[5],fmt[5],ext[5]);
+    	printf(" 7) to convert %s (%s) ==> %s (%s)\n",fmti[6],exti[6],fmt[6],ext[6]);
+    	printf(" 8) to convert %s (%s) ==> %s (%s)\n",fmti[7],exti[7],fmt[7],ext[7]);
+    	printf(" 9) to convert %s (%s) ==> %s (%s)\n",fmti[8],exti[8],fmt[8],ext[8]);
+    	printf(" a) to convert %s (%s) ==> %s (%s)\n",fmti[9],exti[9],fmt[9],ext[9]);
+    	printf(" l) to histogram %s (%s) ==> spectra (per detector)\n",
+                fmti[10],exti[10]);
+    	printf(" p) to probe headers of %s (.Chn/.Spe/.spe) ==> %s (.csv/.json)\n",
+                fmti[11],fmt[11]);
+    	printf(" u) to convert %s (mixed formats) ==> any format\n",fmti[12]);
+    	printf(" k) to pack a list of %s ==> %s (%s)\n",fmti[13],fmt[13],ext[13]);
+    	printf(" n) to convert %s (%s) ==> %s (%s)\n",fmti[14],exti[14],fmt[14],ext[14]);
+    	printf(" r) to integrate ROIs of %s (any format) ==> %s (%s)\n",
+                fmti[15],fmt[15],ext[15]);
+    	printf(" g) to gainmatch a RadWare spectrum\n");
+    	printf(" 0) Quit\n");
+	get_ans(ans,1);
+	if ( (md = mode_num(ans[0])) >= 0) break;
+    }
+    return md;
+} /*END get_mode()*/
+
+/*==========================================================================*/
+/* get_nthr: get number of worker threads (one per CPU, max. MXTHR)         */
+/****************************************************************************/
+int get_nthr(void)
+{
+    int     nthr;
+    
+    if ( (nthr = (int)sysconf(_SC_NPROCESSORS_ONLN)) < 1) nthr = 1;
+    if (nthr > MXTHR) nthr = MXTHR;
+    return nthr;
+} /*END get_nthr()*/
+
+/*==========================================================================*/
+/* get_ofmt: get selectable output format from user input                   */
+/****************************************************************************/
+int get_ofmt(void)
+{
+    int     i;
+    char    ans[10] = "";
+    
+    /*chosen with -f for unattended runs*/
+    if (batch) return ofmt;
+    while(1)
+    {
+        printf("Choose output format:\n");
+        for (i = 0; i < NUMOFMT; i++)
+            printf(" %d) %s (%s)\n",i+1,ofmtn[i],oext[i]);
+	get_ans(ans,1);
+        i = ans[0] - '1';
+ 	if (i >= 0 && i < NUMOFMT) return i;
+    }
+} /*END get_ofmt()*/
+
+/*==========================================================================*/
+/* get_opts: get command line options for unattended (batch) runs           */
+/****************************************************************************/
+int get_opts(int argc, char *argv[], int *srv)
+{
+    int     c, n;
+    char    *p;
+    
+    while ( (c = getopt(argc, argv, "m:f:o:L:g:w:s:W:R:c:A:EB:TKPNF:I:yS:C:b")) != -1)
+    {
+        switch (c)
+        {
+            case 'm':
+                /*a mode on the command line means no prompts at all*/
+                if ( (md = mode_num(optarg[0])) <= 0 || strlen(optarg) != 1)
+                {
+                    printf("Unknown mode %s (one of %s)\n",optarg,MODECH+1);
+                    return -1;
+                }
+                batch = 1;
+                break;
+            case 'f':
+                if ( (ofmt = atoi(optarg) - 1) < 0 || ofmt >= NUMOFMT)
+                {
+                    printf("Output format must be 1-%d\n",NUMOFMT);
+                    return -1;
+                }
+                break;
+            case 'o':
+                strncpy(outopt, optarg, CHLEN-1);
+                break;
+            case 'L':
+                strncpy(layopt, optarg, CHLEN-1);
+                break;
+            case 'g':
+                gain[0] = gain[1] = gain[2] = 0.0;
+                sscanf(optarg, "%f%*[ ,]%f%*[ ,]%f", &gain[0], &gain[1], &gain[2]);
+                break;
+            case 'w':
+                /*only channels lo-hi are read and written*/
+                if (sscanf(optarg, "%d%*[-, ]%d", &wlo, &whi) != 2
+                    || wlo < 0 || whi < wlo || whi >= CHMAX)
+                {
+                    printf("Channel window must be lo-hi within 0-%d\n",CHMAX-1);
+                    return -1;
+                }
+                break;
+            case 's':
+                strncpy(stname, optarg, CHLEN-1);
+                break;
+            case 'W':
+                /*windows lo-hi[,lo-hi...] for the statistics table*/
+                for (p = optarg, nstw = 0; nstw < NSTW && p != NULL
+                        && sscanf(p, "%d-%d", &stw[nstw][0], &stw[nstw][1]) == 2;
+                        nstw++) if ( (p = strchr(p, ',')) != NULL) p++;
+                break;
+            case 'R':
+                strncpy(roiopt, optarg, CHLEN-1);
+                break;
+            case 'c':
+                /*n adjacent channels summed, or channel j moved to
+                    A0 + A1 j + A2 j^2 as by gainmatching*/
+                rbfac = 0;
+                rbg[0] = rbg[1] = rbg[2] = 0.0;
+                if ( (n = sscanf(optarg, "%f%*[ ,]%f%*[ ,]%f",
+                        &rbg[0], &rbg[1], &rbg[2])) == 1)
+                {
+                    rbfac = (int)rbg[0];
+                    rbg[0] = 0.0;
+                }
+                if ( (n == 1 && (rbfac < 2 || rbfac > CHMAX))
+                    || (n > 1 && rbg[1] <= 0.0) || n < 1)
+                {
+                    printf("Rebinning needs a factor of 2 or more"
+                            " or A0,A1[,A2] with A1 > 0\n");
+                    return -1;
+                }
+                break;
+            case 'A':
+                /*expression evaluated for every spectrum before writing*/
+                if (strlen(optarg) >= EXPLEN)
+                {
+                    printf("Expression longer than %d characters\n",EXPLEN-1);
+                    return -1;
+                }
+                strcpy(aropt, optarg);
+                break;
+            case 'E':
+                arerr = 1;
+                break;
+            case 'B':
+                /*SNIP background subtracted before every write*/
+                bgwin = 0;
+                if (sscanf(optarg, "%d%*[, ]%d", &bgit, &bgwin) < 1
+                    || bgit < 1 || bgit > BGMAX || bgwin < 0)
+                {
+                    printf("Background needs 1-%d iterations\n",BGMAX);
+                    return -1;
+                }
+                break;
+            case 'T':
+                bglls = 1;
+                break;
+            case 'K':
+                bgout = 1;
+                break;
+            case 'P':
+                pyrout = 1;
+                break;
+            case 'N':
+                metaout = 0;
+                break;
+            case 'F':
+                strncpy(failopt, optarg, CHLEN-1);
+                break;
+            case 'I':
+                strncpy(walkflt, optarg, CHLEN-1);
+                break;
+            case 'y':
+                ovwr = 1;
+                break;
+            case 'S':
+            case 'C':
+                strncpy(sockname, optarg, CHLEN-1);
+                *srv = (c == 'S') ? 1 : 2;
+                break;
+            case 'b':
+                inlin = 1;
+                break;
+            default:
+                return -1;
+        }
+    }
+    return 0;
+} /*END get_opts()*/
+
+/*==========================================================================*/
+/* get_pars: extract comma or space separated numbers from string ans0	    */
+/****************************************************************************/
+void get_pars(float pars[], int num)
+{
+    int     i, j = 0, k, minus;
+    char    ans0[CHLEN] = "", ans1[40] = "";
+
+    get_line (ans0, CHLEN);
+    
+    for (i = 0; i < num; i++)
+    {
+	k = 0;
+	minus = 0;
+    	memset(ans1,'\0',sizeof(ans1));
+	while ( ans0[j] != '\0' && ! isdigit(ans0[j]) )
+	{
+	    if (ans0[j] == '-') minus = 1;
+	    j++;
+	}
+	if (minus == 1)
+	{
+	    j -= 1;
+	    ans0[j] = '-';
+	}	
+	while( ans0[j] != '\n' && ans0[j] != ' ' && ans0[j] != ','
+		&& j < strlen(ans0) ) ans1[k++] = ans0[j++];
+	
+	j++;
+	pars[i] = atof(ans1);
+    }
+    printf("\n");
+} /*END get_pars()*/
+
+/*==========================================================================*/
+/* get_val: extract a number from string ans0	    	    	    	    */
+/****************************************************************************/
+void get_val(float *val)
+{
+    int     j = 0, k, minus;
+    char    ans0[CHLEN] = "", ans1[40] = "";
+
+    get_line(ans0, CHLEN);
+    
+    k = 0;
+    minus = 0;
+    memset(ans1,'\0',sizeof(ans1));
+    while ( ans0[j] != '\0' && ! isdigit(ans0[j]) )
+    {
+    	if (ans0[j] == '-') minus = 1;
+    	j++;
+    }
+    if (minus == 1)
+    {
+    	j -= 1;
+    	ans0[j] = '-';
+    }	    
+    while( ans0[j] != '\n' && ans0[j] != ' ' && ans0[j] != ','
+    	    && j < strlen(ans0) ) ans1[k++] = ans0[j++];
+
+    j++;
+    *val = atof(ans1);
+    printf("\n");
+} /*END get_val()*/
+
+/*==========================================================================*/
+/* idx_read: read layout index "name.idx" of a file of bytes bytes, return  */
+/*  the number of spectra per set, 0 if there is no (usable) index          */
+/****************************************************************************/
+int idx_read(char name[], long bytes)
+{
+    int     i, k, n, f, l;
+    long    mt = 0;
+    double  t;
+    char    iname[CHLEN+5], line[CHLEN] = "";
+    struct  stat statbuf;
+    FILE    *fp;
+    
+    free(layidx.first);
+    free(layidx.last);
+    free(layidx.tot);
+    memset(&layidx, 0, sizeof(layidx));
+    sprintf(iname, "%s.idx", name);
+    if ( (fp = fopen(iname, "r")) == NULL) return 0;
+    skip_hash(fp);
+    get_line_file(fp, line, CHLEN-1);
+    k = sscanf(line, "%d %d %d %d %2s %c %ld", &layidx.set, &layidx.mxsp,
+            &layidx.numch, &layidx.sz, layidx.type, &layidx.endian, &mt);
+    i = 1;
+    if (k < 6 || (long)layidx.set*layidx.mxsp*layidx.numch*layidx.sz != bytes
+        || layidx.mxsp < 1 || layidx.numch < 1 || layidx.numch > CHMAX)
+    {
+        printf("%s***Layout in %s does not match the file ...ignored%s\n",
+                clr[1],iname,clr[0]);
+        fclose(fp);
+        layidx.mxsp = 0;
+        return 0;
+    }
+    if ( (layidx.endian == 'B') != (*(char *)&i != 1) )
+    {
+        printf("%s***%s is for the other byte order ...ignored%s\n",
+                clr[1],iname,clr[0]);
+        fclose(fp);
+        layidx.mxsp = 0;
+        return 0;
+    }
+    
+    /*per-spectrum ranges only apply to the file as it was indexed*/
+    n = layidx.set*layidx.mxsp;
+    layidx.first = (int *) malloc(n*sizeof(int));
+    layidx.last = (int *) malloc(n*sizeof(int));
+    layidx.tot = (double *) malloc(n*sizeof(double));
+    if (k == 7 && stat(name, &statbuf) == 0
+        && (long)statbuf.st_mtime == mt && layidx.tot)
+    {
+        skip_hash(fp);
+        for (i = 0; i < n && fscanf(fp, "%d %d %d %lf", &k, &f, &l, &t) == 4
+                && k == i; i++)
+        {
+            layidx.first[i] = f;
+            layidx.last[i] = l;
+            layidx.tot[i] = t;
+        }
+        layidx.fresh = (i == n);
+    }
+    fclose(fp);
+    printf("Layout from %s: %d set(s) of %d spectra, %d channels "
+            "(%d bytes/channel)\n", iname, layidx.set, layidx.mxsp,
+            layidx.numch, layidx.sz);
+    return layidx.mxsp;
+} /*END idx_read()*/
+
+/*==========================================================================*/
+/* idx_write: write layout index "name.idx" with each spectrum's range      */
+/****************************************************************************/
+int idx_write(char name[], int set, int mxsp, int numch, int sz, char type[])
+{
+    int     i, j, fd, f, l, n = set*mxsp, one = 1;
+    double  t, v;
+    char    iname[CHLEN+5];
+    unsigned char *map, *p;
+    struct  stat statbuf;
+    FILE    *fp;
+    
+    if ( (fd = open(name, O_RDONLY)) < 0) return -1;
+    if (fstat(fd, &statbuf) < 0 || statbuf.st_size < (long)n*numch*sz
+        || (map = (unsigned char *) mmap(NULL, statbuf.st_size, PROT_READ,
+            MAP_PRIVATE, fd, 0)) == MAP_FAILED)
+    {
+        close(fd);
+        return -1;
+    }
+    close(fd);
+    sprintf(iname, "%s.idx", name);
+    if ( (fp = out_open(iname, "w")) == NULL)
+    {
+        munmap(map, statbuf.st_size);
+        return -1;
+    }
+    fprintf(fp, "# spec_conv layout index: sets spectra channels bytes/channel"
+            " type byte-order mtime\n%d %d %d %d %s %c %ld\n"
+            "# spectrum first last total (first = last = -1 if empty)\n",
+            set, mxsp, numch, sz, type, *(char *)&one == 1 ? 'L' : 'B',
+            (long)statbuf.st_mtime);
+    for (i = 0; i < n; i++)
+    {
+        p = map + (long)i*numch*sz;
+        for (j = 0, f = l = -1, t = 0.0; j < numch; j++)
+        {
+            if (sz == 2) v = (type[0] == 'S') ? ((short *)p)[j]
+                : ((unsigned short *)p)[j];
+            else if (type[0] == 'F') v = ((float *)p)[j];
+            else if (type[0] == 'U') v = ((unsigned int *)p)[j];
+            else v = ((int *)p)[j];
+            if (v == 0.0) continue;
+            if (f < 0) f = j;
+            l = j;
+            t += v;
+        }
+        fprintf(fp, "%d %d %d %.0f\n", i, f, l, t);
+    }
+    munmap(map, statbuf.st_size);
+    if (out_close(fp) != 0) return -1;
+    printf("Layout index written to %s\n", iname);
+    return 0;
+} /*END idx_write()*/
+
+/*===========================================================================*/
+/* itoa: convert integer n to string s*/
+/*****************************************************************************/
+void itoa(int n, char s[])
+{
+    int i = 0, sign;
+    
+    /*record sign and make n positive*/
+    if ((sign = n) < 0) n = -n;
+
+    /* generates digits in reverse order */
+    do {
+        /*get next digit*/
+    	s[i++] = n % 10 + '0';
+      /* delete it*/
+    } while ((n /= 10) > 0);
+    if (sign < 0) s[i++] = '-';
+    
+    s[i] = '\0';
+    reverse(s);
+} /*END itoa()*/
+
+/*==========================================================================*/
+/* jnl_begin: start converting list entry entry                             */
+/****************************************************************************/
+void jnl_begin(char entry[])
+{
+    if (! journal.on) return ;
+    snprintf(journal.cur, sizeof(journal.cur), "%s", entry);
+    journal.outs[0] = '\0';
+    journal.nf = nfail;
+} /*END jnl_begin()*/
+
+/*==========================================================================*/
+/* jnl_cmp: compare two entries for qsort() and bsearch()                   */
+/****************************************************************************/
+int jnl_cmp(const void *a, const void *b)
+{
+    return strcmp(*(char **)a, *(char **)b);
+} /*END jnl_cmp()*/
+
+/*==========================================================================*/
+/* jnl_close: stop journaling, the journal is removed unless the run was    */
+/*            stopped by an error (rc < 0)                                  */
+/****************************************************************************/
+void jnl_close(int rc)
+{
+    int     i;
+    
+    if (! journal.on) return ;
+    journal.on = 0;
+    if (rc >= 0) unlink(journal.name);
+    for (i = 0; i < journal.n; i++) free(journal.done[i]);
+    free(journal.done);
+    journal.done = NULL;
+    journal.n = 0;
+} /*END jnl_close()*/
+
+/*==========================================================================*/
+/* jnl_end: journal the entry being converted, with its outputs, unless it  */
+/*          failed; queued behind its outputs if they are written by the   */
+/*          pipeline                                                        */
+/****************************************************************************/
+void jnl_end(void)
+{
+    FILE    *fp;
+    
+    if (! journal.on || ! strlen(journal.cur)) return ;
+    if (nfail == journal.nf && (fp = spec_open(journal.name, "a")) != NULL)
+    {
+        fprintf(fp, "%s%s\n", journal.cur, journal.outs);
+        spec_close(fp);
+    }
+    journal.cur[0] = '\0';
+} /*END jnl_end()*/
+
+/*==========================================================================*/
+/* jnl_filter: remove entries converted by the earlier run from names[]     */
+/****************************************************************************/
+void jnl_filter(char **names, int *n)
+{
+    int     i, j;
+    
+    if (! journal.on || journal.n == 0) return ;
+    for (i = 0, j = 0; i < *n; i++)
+    {
+        if (jnl_skip(names[i])) free(names[i]);
+        else names[j++] = names[i];
+    }
+    *n = j;
+} /*END jnl_filter()*/
+
+/*==========================================================================*/
+/* jnl_open: journal the entries of list file list in list.jnl; if it was   */
+/*           left by a run with the same options, its entries are skipped   */
+/****************************************************************************/
+int jnl_open(char list[])
+{
+    int     i, k, mx = 1024;
+    char    opt[REQMAX], ln[REQMAX], *p;
+    FILE    *fp;
+    
+    if (journal.on) return 0;
+    list_side(journal.name, list, ".jnl");
+    /*the run is described by its options, one line*/
+    k = sprintf(opt, "# spec_conv journal of %s: ",
+            walker.on ? walker.desc : list);
+    k += put_opts(opt + k);
+    for (i = 0; i < k; i++) if (opt[i] == '\0') opt[i] = ' ';
+    opt[k-1] = '\n';
+    opt[k] = '\0';
+    
+    journal.n = 0;
+    journal.done = NULL;
+    if ( (fp = fopen(journal.name, "r")) != NULL)
+    {
+        if (fgets(ln, sizeof(ln), fp) && ! strcmp(ln, opt))
+        {
+            journal.done = (char **) malloc(mx*sizeof(char *));
+            while (journal.done && fgets(ln, sizeof(ln), fp))
+            {
+                /*only whole lines: the last may have been cut short*/
+                if ( (p = strchr(ln, '\n')) == NULL) break;
+                *p = '\0';
+                if ( (p = strchr(ln, '\t')) != NULL) *p = '\0';
+                if (journal.n == mx)
+                {
+                    mx *= 2;
+                    journal.done = (char **) realloc(journal.done, mx*sizeof(char *));
+                }
+                journal.done[journal.n++] = strdup(ln);
+            }
+            if (journal.done) qsort(journal.done, journal.n, sizeof(char *), jnl_cmp);
+            else journal.n = 0;
+        }
+        else printf("Journal %s is of another run ...starting again\n",
+                journal.name);
+        fclose(fp);
+    }
+    if (journal.n > 0)
+        printf("Resuming %s: %d entries already converted\n", list, journal.n);
+    else if ( (fp = fopen(journal.name, "w")) == NULL
+        || fputs(opt, fp) == EOF || fclose(fp) != 0)
+    {
+        printf("Cannot open file: %s \n", journal.name);
+        return -1;
+    }
+    journal.cur[0] = '\0';
+    journal.on = 1;
+    return 0;
+} /*END jnl_open()*/
+
+/*==========================================================================*/
+/* jnl_out: add output name to the journal line of the current entry        */
+/****************************************************************************/
+void jnl_out(char name[])
+{
+    int     n;
+    
+    if (! journal.on || ! strlen(journal.cur)) return ;
+    n = strlen(journal.outs);
+    if (n + strlen(name) + 2 < JNLOUT) sprintf(journal.outs + n, "\t%s", name);
+} /*END jnl_out()*/
+
+/*==========================================================================*/
+/* jnl_skip: 1 if entry was converted by the earlier run, else 0            */
+/****************************************************************************/
+int jnl_skip(char entry[])
+{
+    char    *e = entry;
+    
+    if (! journal.on || journal.n == 0) return 0;
+    return bsearch(&e, journal.done, journal.n, sizeof(char *), jnl_cmp) != NULL;
+} /*END jnl_skip()*/
+
+/*==========================================================================*/
+/* json_num: print v as a JSON number, null if it is not a number           */
+/****************************************************************************/
+void json_num(FILE *fp, double v)
+{
+    if (isfinite(v)) fprintf(fp, "%g", v);
+    else fprintf(fp, "null");
+} /*END json_num()*/
+
+/*==========================================================================*/
+/* json_str: print s as a JSON string, quoted and escaped                   */
+/****************************************************************************/
+void json_str(FILE *fp, char s[])
+{
+    unsigned char *p;
+    
+    fputc('"', fp);
+    for (p = (unsigned char *) s; *p; p++)
+    {
+        if (*p == '"' || *p == '\\') fprintf(fp, "\\%c", *p);
+        else if (*p < 0x20) fprintf(fp, "\\u%04x", *p);
+        else fputc(*p, fp);
+    }
+    fputc('"', fp);
+} /*END json_str()*/
+
+/*==========================================================================*/
+/* list_side: name of a file kept next to list file list, with extension    */
+/*            ext instead of the list's own                                 */
+/****************************************************************************/
+void list_side(char out[], char list[], char ext[])
+{
+    strncpy(out, list, CHLEN-1);
+    out[CHLEN-1] = '\0';
+    if (strrchr(out,'/') && strrchr(out,'.') < strrchr(out,'/'))
+        strcat(out, ext);
+    else set_ext(out, ext);
+} /*END list_side()*/
+
+/*==========================================================================*/
+/* load_file: read the whole of file name into a new buffer of len bytes    */
+/****************************************************************************/
+char *load_file(char name[], long *len)
+{
+    char    *buf = NULL;
+    FILE    *fp;
+    
+    /*through spec_open() so prefetched and inline input are used*/
+    if ( (fp = spec_open(name, "r")) == NULL)
+    {
+    	printf("Cannot open file: %s \n", name);
+    	return NULL;
+    }
+    fseek(fp, 0, SEEK_END);
+    *len = ftell(fp);
+    rewind(fp);
+    if (*len <= 0 || (buf = (char *) malloc(*len)) == NULL
+        || (long)fread(buf, 1, *len, fp) != *len)
+    {
+        printf("Read error occurred for file: %s\n", name);
+        free(buf);
+        spec_close(fp);
+        return NULL;
+    }
+    spec_close(fp);
+    return buf;
+} /*END load_file()*/
+
+/*==========================================================================*/
+/* load_lst: read all spectrum names from a list file into an array        */
+/****************************************************************************/
+char **load_lst(char listname[], int *n)
+{
+    int     mx = 1024;
+    float   g[3];
+    char    name[CHLEN] = "", **names;
+    FILE    *flst;
+    
+    if (walker.on) return walk_load(n);
+    if ((flst = fopen(listname, "r" )) == NULL)
+    {
+    	printf("Cannot open file: %s \n", listname);
+    	return NULL;
+    }
+    names = (char **) malloc(mx*sizeof(char *));
+    *n = 0;
+    /*gainmatching coefficients following each name are skipped*/
+    while (get_entry(flst, name, md == NUMOPT ? g : NULL) == 1)
+    {
+        if (*n == mx)
+        {
+            mx *= 2;
+            names = (char **) realloc(names, mx*sizeof(char *));
+        }
+        names[(*n)++] = strdup(name);
+    }
+    fclose(flst);
+    if (*n == 0)
+    {
+        free(names);
+        return NULL;
+    }
+    return names;
+} /*END load_lst()*/
+
+/*==========================================================================*/
+/* lm_field: extract a 1, 2 or 4 byte (or float, sz = -4) record field      */
+/****************************************************************************/
+unsigned int lm_field(unsigned char *p, int sz, int swap)
+{
+    float   f;
+    unsigned int v;
+    unsigned char b[4];
+    
+    if (sz == 1) return (unsigned int)p[0];
+    else if (sz == 2)
+    {
+        if (swap) return ( (unsigned int)p[0] << 8 ) | p[1];
+        return ( (unsigned int)p[1] << 8 ) | p[0];
+    }
+    if (swap) v = ( (unsigned int)p[0] << 24 ) | ( (unsigned int)p[1] << 16 )
+                | ( (unsigned int)p[2] << 8 ) | p[3];
+    else v = ( (unsigned int)p[3] << 24 ) | ( (unsigned int)p[2] << 16 )
+                | ( (unsigned int)p[1] << 8 ) | p[0];
+    if (sz == 4) return v;
+    
+    /*float energy: reinterpret the bytes and truncate, negatives rejected*/
+    b[0] = v & 0xff; b[1] = (v >> 8) & 0xff;
+    b[2] = (v >> 16) & 0xff; b[3] = (v >> 24) & 0xff;
+    memcpy(&f, b, 4);
+    if (f < 0.0 || f >= 4294967295.0) return 0xffffffff;
+    return (unsigned int)f;
+} /*END lm_field()*/
+
+/*==========================================================================*/
+/* lm_hist: histogram a list-mode file with nthr threads into hist[]        */
+/****************************************************************************/
+long lm_hist(char name[], unsigned int *hist, int nthr)
+{
+    long    nrec, nrej = 0, hsz;
+    int     fd, i, j, k, nh, atom = 0;
+    struct  stat statbuf;
+    struct  lmthread targ[MXTHR];
+    pthread_t tid[MXTHR];
+    
+    /*open read only list-mode file*/
+    if ( (fd = open(name, O_RDONLY)) < 0)
+    {
+    	printf("Cannot open file: %s\n", name);
+	return -1;
+    }
+    fstat(fd, &statbuf);
+    nrec = ( (long)statbuf.st_size - lmlayout.hdr )/lmlayout.reclen;
+    if (nrec < 1)
+    {
+        printf("No list-mode records found in file: %s\n", name);
+        close(fd);
+        return -1;
+    }
+    if ( ( (long)statbuf.st_size - lmlayout.hdr )%lmlayout.reclen != 0)
+        printf("%s***Warning: file size is not a multiple of %d byte records."
+                " Last partial record ignored%s\n",clr[1],lmlayout.reclen,clr[0]);
+    
+    /*one histogram set per thread, or a single shared atomic set*/
+    hsz = (long)lmlayout.ndet*lmlayout.numch;
+    if ( (long)nthr*hsz*sizeof(unsigned int) > LMPRIV ) atom = 1;
+    if (nthr > nrec) nthr = (int)nrec;
+    nh = atom ? 1 : nthr;
+    memset(hist, 0, nh*hsz*sizeof(unsigned int));
+    
+    for (i = 0; i < nthr; i++)
+    {
+        targ[i].fd = fd;
+        targ[i].r0 = nrec*i/nthr;
+        targ[i].r1 = nrec*(i+1)/nthr;
+        targ[i].hist = atom ? hist : hist + i*hsz;
+        targ[i].atom = atom;
+        targ[i].nrej = 0;
+        targ[i].err = 0;
+        if (pthread_create(&tid[i], NULL, lm_thread, &targ[i]) != 0)
+        {
+            /*histogram this range in the calling thread instead*/
+            lm_thread(&targ[i]);
+            tid[i] = pthread_self();
+        }
+    }
+    for (i = 0, k = 0; i < nthr; i++)
+    {
+        if (! pthread_equal(tid[i], pthread_self()) ) pthread_join(tid[i], NULL);
+        nrej += targ[i].nrej;
+        k |= targ[i].err;
+    }
+    close(fd);
+    if (k)
+    {
+        printf("Read error occurred for file: %s\n", name);
+        return -1;
+    }
+    
+    /*merge private histograms into the first*/
+    for (i = 1; i < nh; i++)
+        for (j = 0; j < hsz; j++) hist[j] += hist[i*hsz + j];
+    
+    printf("%s: %ld events histogrammed with %d thread(s)%s, %ld rejected\n",
+            name, nrec - nrej, nthr, atom ? " (atomic)" : "", nrej);
+    return nrec - nrej;
+} /*END lm_hist()*/
+
+/*==========================================================================*/
+/* lm_thread: histogram records r0 to r1-1 of a list-mode file              */
+/****************************************************************************/
+void *lm_thread(void *arg)
+{
+    struct  lmthread *t = (struct lmthread *)arg;
+    unsigned char *buf, *p;
+    unsigned int det, en;
+    long    r, n, i;
+    int     reclen = lmlayout.reclen, numch = lmlayout.numch;
+    
+    if ( (buf = (unsigned char *) malloc( (long)LMBLK*reclen )) == NULL)
+    {
+        t->err = 1;
+        return NULL;
+    }
+    for (r = t->r0; r < t->r1; r += n)
+    {
+        n = t->r1 - r;
+        if (n > LMBLK) n = LMBLK;
+        if (pread(t->fd, buf, n*reclen, lmlayout.hdr + r*reclen) != n*reclen)
+        {
+            t->err = 1;
+            break;
+        }
+        for (i = 0, p = buf; i < n; i++, p += reclen)
+        {
+            det = lm_field(p + lmlayout.detoff, lmlayout.detsz, lmlayout.swap);
+            en = lm_field(p + lmlayout.enoff, lmlayout.ensz, lmlayout.swap)
+                    /lmlayout.comp;
+            if (det >= (unsigned int)lmlayout.ndet || en >= (unsigned int)numch)
+            {
+                t->nrej++;
+                continue;
+            }
+            if (t->atom)
+                __atomic_fetch_add(&t->hist[(long)det*numch + en], 1,
+                        __ATOMIC_RELAXED);
+            else t->hist[(long)det*numch + en]++;
+        }
+    }
+    free(buf);
+    return NULL;
+} /*END lm_thread()*/
+
+/*===========================================================================*/
+/* maestro_read: read the maestro format spectrum                            */
+/*****************************************************************************/
+int maestro_read(char name[])
+{
+    int *counts, i = 0, n;
+    long size;
+    char dt[10] = "";
+    FILE *fsp;
+        
+    /*opens read only Maestro file*/
+    if ( (fsp = spec_open(name, "r")) == NULL)
+    {
+    	printf("Cannot open file: %s\n", name);
+	return -1;
+    }    
+    /*clear the header*/
+    memset(&maest_header, 0, sizeof(maest_header));
+    /*construct Maestro header*/
+    fread(&maest_header, sizeof(maest_header), 1, fsp);
+        
+/*    printf(" maest_header.q1 = %d\n maest_header.q2 = %d \n"
+	   " maest_header.q3 = %d\n maest_header.q4 = %d \n"
+	   " maest_header.real = %d\n maest_header.lve = %d \n"
+	   " maest_header.dt = %s\n maest_header.sttm = %s \n"
+	   " maest_header.off = %d\n maest_header.channels = %d\n",
+	    maest_header.q1, maest_header.q2, maest_header.q3,
+	    maest_header.q4, maest_header.real, maest_header.lve,
+            maest_header.dt, maest_header.sttm, maest_header.off,
+            maest_header.channels);*/
+    
+    /*header tag -1 in either byte order*/
+    if (maest_header.q1 != -1)
+    {
+    	printf("Unrecognised format. Exiting.....\n");
+	spec_close(fsp);
+    	return -1;
+    }
+    /*unix byte swapping option: swapped if only the swapped length fits
+        the file size (32 byte header, 512 byte trailer), without a
+        trailer if there are fewer than 128 channels*/
+    fseek(fsp, 0, SEEK_END);
+    size = ftell(fsp);
+    fseek(fsp, sizeof(maest_header), SEEK_SET);
+    n = (unsigned short)maest_header.channels;
+    if (size != 544 + 4L*n && (size == 544 + 4L*cswap2(n) || n < 128))
+    {
+	/*swap the bytes in the headers*/
+    	maest_header.channels = cswap2(maest_header.channels);
+    	maest_header.off = cswap2(maest_header.off);
+	maest_header.real = cswap4(maest_header.real);
+	maest_header.lve = cswap4(maest_header.lve);
+        
+	printf(".......SWAPPING BYTES read from file.......\n");
+    	/*allocate sufficient memory for spectrum*/
+    	counts = (int *) malloc( maest_header.channels*sizeof(int) );
+    	/*read the data*/
+	fread(counts, maest_header.channels*sizeof(int), 1, fsp);
+	/*read the trailer*/
+	fread(&maest_trailer, sizeof(maest_trailer), 1, fsp);
+    	maest_trailer.g[0] = cswap4(maest_trailer.g[0]);
+    	maest_trailer.g[1] = cswap4(maest_trailer.g[1]);
+    	maest_trailer.g[2] = cswap4(maest_trailer.g[2]);
+
+      	/*fill spectrum array*/
+    	for (i = 0; i < (int) maest_header.channels; i++)
+	    swapb4( (char *) (counts + i) );	
+    } /*end of byte swapping loop for unix*/    
+    else
+    {
+    	/*allocate sufficient memory for spectrum*/
+    	counts = (int *) malloc( maest_header.channels*sizeof(int) );
+	/*read the data*/
+	fread(counts, maest_header.channels*sizeof(int), 1, fsp);
+	/*read the trailer*/
+	fread(&maest_trailer, sizeof(maest_trailer), 1, fsp);
+    }
+    /*fill spectrum array, the first channel in the file is the offset*/
+    if (maest_header.off < 0 || maest_header.off >= CHMAX) maest_header.off = 0;
+    for (i = 0; i < maest_header.channels && i + maest_header.off < CHMAX; i++)
+        spectrum[i + maest_header.off] = (float)*(counts + i);
+    
+    
+    /*print real and live times to screen and convert from 20ms units to sec*/
+    /*Copy day and month*/
+    strncpy(dt, maest_header.dt, 5);
+    /*check year, if maest_header.dt[7] == 1 year is 2000+YY else 1900+YY*/
+    if (maest_header.dt[7] == '1') strncpy(dt+5, "20", 2);
+    else strncpy(dt+5, "19", 2);
+    strncpy(dt+7, maest_header.dt+5, 2);
+    dt[9] = '\0';
+    printf("Spectrum info: %s at %c%c:%s\n"
+           "               Real time: %d s\n"
+           "               Live time: %d s\n",dt,maest_header.sttm[0],
+            maest_header.sttm[1],maest_header.sttm+2,
+            (int)(maest_header.real*0.02),(int)(maest_header.lve*0.02));
+    
+    /*print potentially useful trailer information*/
+    printf("Maestro energy calibration coeffs: %f %f %f\n",
+          maest_trailer.g[0],maest_trailer.g[1],maest_trailer.g[2]);
+    
+    /*keep it all for the writers*/
+    strcpy(meta.fmt, "Maestro_Chn");
+    meta.real = maest_header.real*0.02;
+    meta.live = maest_header.lve*0.02;
+    strcpy(meta.date, dt);
+    /*seconds are the ASCII of q4 (if set)*/
+    dt[0] = ((char *)&maest_header.q4)[0];
+    dt[1] = ((char *)&maest_header.q4)[1];
+    if (! isdigit(dt[0]) || ! isdigit(dt[1])) dt[0] = dt[1] = '0';
+    snprintf(meta.time, sizeof(meta.time), "%c%c:%c%c:%c%c",
+            maest_header.sttm[0], maest_header.sttm[1], maest_header.sttm[2],
+            maest_header.sttm[3], dt[0], dt[1]);
+    meta.off = maest_header.off;
+    memcpy(meta.cal, maest_trailer.g, sizeof(meta.cal));
+    
+    free(counts);
+    spec_close(fsp);
+    return i + maest_header.off;
+} /*END maestro_read()*/
+
+/*==========================================================================*/
+/* meta_date: year, month, day and h:m:s of the start date and time in meta */
+/*            (DDMMMYY[YY], MM/DD/YYYY, DD.MM.YYYY or YYYY-MM-DD), -1 if  */
+/*            there is no date                                              */
+/****************************************************************************/
+int meta_date(int *y, int *mo, int *d, int *hms)
+{
+    static char mon[] = "JANFEBMARAPRMAYJUNJULAUGSEPOCTNOVDEC";
+    char    m[4], sep[2];
+    int     a, b, c, i;
+    
+    hms[0] = hms[1] = hms[2] = 0;
+    if (sscanf(meta.date, "%2d%3[A-Za-z]%d", &a, m, &c) == 3)
+    {
+        for (i = 0; i < 3; i++) m[i] = toupper(m[i]);
+        for (i = 0; i < 12 && strncmp(mon + 3*i, m, 3); i++) ;
+        b = i + 1;
+    }
+    else if (sscanf(meta.date, "%d%1[/.-]%d%*[/.-]%d", &a, sep, &b, &c) == 4)
+    {
+        /*Maestro writes MM/DD/YYYY, others DD.MM.YY or DD-MM-YY*/
+        if (a > 31) { i = a; a = c; c = i; }
+        else if (a <= 12 && b > 12) { i = a; a = b; b = i; }
+        else if (sep[0] == '/' && a <= 12) { i = a; a = b; b = i; }
+    }
+    else return -1;
+    if (c < 100) c += c < 70 ? 2000 : 1900;
+    if (a < 1 || a > 31 || b < 1 || b > 12) return -1;
+    *y = c;
+    *mo = b;
+    *d = a;
+    sscanf(meta.time, "%d:%d:%d", &hms[0], &hms[1], &hms[2]);
+    for (i = 0; i < 3; i++) if (hms[i] < 0 || hms[i] > 59) hms[i] = 0;
+    return 0;
+} /*END meta_date()*/
+
+/*==========================================================================*/
+/* meta_json: print metadata m of file as a JSON object, closed and with    */
+/*            the ROIs etc. if all, else left open for more fields          */
+/****************************************************************************/
+void meta_json(FILE *fp, char file[], struct specmeta *m, int all)
+{
+    int     i;
+    
+    /*unknown times (< 0) and values that are not numbers are null*/
+    fprintf(fp, "{\"file\":");
+    json_str(fp, file);
+    fprintf(fp, ",\"format\":");
+    json_str(fp, m->fmt);
+    fprintf(fp, ",\"live_s\":");
+    json_num(fp, m->live < 0.0 ? NAN : m->live);
+    fprintf(fp, ",\"real_s\":");
+    json_num(fp, m->real < 0.0 ? NAN : m->real);
+    fprintf(fp, ",\"date\":");
+    json_str(fp, m->date);
+    fprintf(fp, ",\"time\":");
+    json_str(fp, m->time);
+    fprintf(fp, ",\"channels\":%d,\"offset\":%d,\"cal\":[", m->channels,
+            m->off);
+    for (i = 0; i < 3; i++)
+    {
+        if (i) fprintf(fp, ",");
+        json_num(fp, m->cal[i]);
+    }
+    fprintf(fp, "],\"name\":");
+    json_str(fp, m->name);
+    if (! all) return ;
+    if (m->fit[0] != 0.0 || m->fit[1] != 0.0)
+    {
+        fprintf(fp, ",\"fit\":[");
+        json_num(fp, m->fit[0]);
+        fprintf(fp, ",");
+        json_num(fp, m->fit[1]);
+        fprintf(fp, "]");
+    }
+    for (i = 0; i < m->nroi; i++)
+        fprintf(fp, "%s[%d,%d]", i ? "," : ",\"rois\":[", m->roi[i][0],
+                m->roi[i][1]);
+    if (m->nroi > 0) fprintf(fp, "]");
+    if (m->nsp > 1) fprintf(fp, ",\"spectrum\":%d,\"spectra\":%d,\"bytes\":%d",
+            m->sp, m->nsp, m->sz);
+    fprintf(fp, "}");
+} /*END meta_json()*/
+
+/*==========================================================================*/
+/* meta_read: fill metadata the reader did not find from sidecar name.json  */
+/****************************************************************************/
+int meta_read(char name[])
+{
+    char    jname[CHLEN+5], buf[8192], *p;
+    int     i, n;
+    FILE    *fp;
+    
+    sprintf(jname, "%s.json", name);
+    if ( (fp = fopen(jname, "r")) == NULL) return 0;
+    n = fread(buf, 1, sizeof(buf) - 1, fp);
+    fclose(fp);
+    buf[n] = '\0';
+    if (strncmp(buf, "{\"file\":", 8)) return 0;
+    
+    if (meta.live < 0.0 && (p = strstr(buf, "\"live_s\":")))
+        sscanf(p + 9, "%f", &meta.live);
+    if (meta.real < 0.0 && (p = strstr(buf, "\"real_s\":")))
+        sscanf(p + 9, "%f", &meta.real);
+    if (! strlen(meta.date) && (p = strstr(buf, "\"date\":\"")))
+        sscanf(p + 8, "%11[^\"]", meta.date);
+    if (! strlen(meta.time) && (p = strstr(buf, "\"time\":\"")))
+        sscanf(p + 8, "%9[^\"]", meta.time);
+    if (meta.cal[0] == 0.0 && meta.cal[1] == 0.0 && meta.cal[2] == 0.0
+            && (p = strstr(buf, "\"cal\":[")))
+        sscanf(p + 7, "%f,%f,%f", &meta.cal[0], &meta.cal[1], &meta.cal[2]);
+    if (! strlen(meta.name) && (p = strstr(buf, "\"name\":\"")))
+        sscanf(p + 8, "%8[^\"]", meta.name);
+    if (meta.fit[0] == 0.0 && meta.fit[1] == 0.0 && (p = strstr(buf, "\"fit\":[")))
+        sscanf(p + 7, "%f,%f", &meta.fit[0], &meta.fit[1]);
+    if (meta.nroi == 0 && (p = strstr(buf, "\"rois\":[")))
+    {
+        for (p += 8, i = 0; i < MXROI && sscanf(p, "[%d,%d]", &meta.roi[i][0],
+                &meta.roi[i][1]) == 2; )
+        {
+            meta.nroi = ++i;
+            if ( (p = strchr(p, ']')) == NULL || p[1] != ',') break;
+            p += 2;
+        }
+    }
+    return 1;
+} /*END meta_read()*/
+
+/*==========================================================================*/
+/* meta_write: write metadata the output format has no room for as sidecar  */
+/*             "name.json" (nothing if there is none beyond the counts)    */
+/****************************************************************************/
+void meta_write(char name[])
+{
+    char    jname[CHLEN+5];
+    FILE    *fp;
+    
+    if (meta.live < 0.0 && meta.real < 0.0 && ! strlen(meta.date)
+        && meta.cal[0] == 0.0 && meta.cal[1] == 0.0 && meta.cal[2] == 0.0
+        && meta.fit[0] == 0.0 && meta.fit[1] == 0.0 && meta.nroi == 0
+        && meta.nsp <= 1) return ;
+    
+    sprintf(jname, "%s.json", name);
+    if ( (fp = spec_open(jname, "w")) == NULL)
+    {
+        printf("Cannot open file: %s \n", jname);
+        return ;
+    }
+    meta_json(fp, strrchr(name,'/') ? strrchr(name,'/')+1 : name, &meta, 1);
+    fprintf(fp, "\n");
+    spec_close(fp);
+} /*END meta_write()*/
+
+/*==========================================================================*/
+/* mode_num: mode number of a menu character, -1 if not an option           */
+/****************************************************************************/
+int mode_num(char c)
+{
+    char    *p;
+    
+    if (c == '\0' || (p = strchr(MODECH, tolower(c))) == NULL) return -1;
+    return (int)(p - MODECH);
+} /*END mode_num()*/
+
+/*==========================================================================*/
+/* mspec_type: element type (UI, I, US, S or F) from the letters before the */
+/*             trailing "__" of a multiple spectrum name, UI if there are  */
+/*             none                                                         */
+/****************************************************************************/
+void mspec_type(char name[], char type[])
+{
+    int     i, n;
+    char    *p = strrchr(name, '_');
+    
+    strcpy(type, "UI");
+    if (p == NULL || p - name < 2 || *(p-1) != '_') return;
+    for (n = 0; n < 3 && p - 2 - n >= name && isalpha(*(p-2-n)); n++) ;
+    if (n < 1 || n > 2) return;
+    for (i = 0; i < n; i++) type[i] = toupper(*(p-1-n+i));
+    type[n] = '\0';
+} /*END mspec_type()*/
+
+/*==========================================================================*/
+/* npy_header: make a NumPy .npy v1.0 header for a C-ordered array          */
+/****************************************************************************/
+int npy_header(char hdr[], char descr[], int rows, int cols)
+{
+    int     n;
+    
+    /*magic, version 1.0, 2 byte header length, then a python dict padded
+        with spaces and ending in a newline so the data start is aligned*/
+    memcpy(hdr, "\x93NUMPY\x01\x00", 8);
+    if (rows > 0) n = sprintf(hdr+10, "{'descr': '%s', 'fortran_order': False,"
+            " 'shape': (%d, %d), }", descr, rows, cols);
+    else n = sprintf(hdr+10, "{'descr': '%s', 'fortran_order': False,"
+            " 'shape': (%d,), }", descr, cols);
+    while ( (10 + n + 1)%64 != 0) hdr[10 + n++] = ' ';
+    hdr[10 + n++] = '\n';
+    hdr[8] = n & 0xff;
+    hdr[9] = (n >> 8) & 0xff;
+    return 10 + n;
+} /*END npy_header()*/
+
+/*==========================================================================*/
+/* npy_mspec: write all spectra of an Xtrack file as one 2D .npy array      */
+/****************************************************************************/
+int npy_mspec(char name[], char outname[])
+{
+    int     fd, fo, set = 1, mxsp = 0, numch = 0, sz = 4, n, bmo = batch;
+    long    bytes, fsz, w, k;
+    char    hdr[256], descr[5], tmp[CHLEN+12], type[3], *data;
+    
+    bytes = convert_bytes(name);
+    /*layout from the index, the __set_mxsp_numch_UI__ name, else a single
+        spectrum*/
+    if (idx_read(name, bytes) > 0)
+    {
+        mxsp = layidx.mxsp*layidx.set;
+        numch = layidx.numch;
+        sz = layidx.sz;
+    }
+    else if (strchr(name,'_') && ! strncmp( strchr(name,'_'), "__", 2 ) )
+    {
+        batch = 1;
+        decode_mspec_name(name, &set, &mxsp, &numch, &sz, bytes);
+        batch = bmo;
+    }
+    if (mxsp < 1 || numch < 1)
+    {
+        mxsp = 1;
+        sz = 4;
+        numch = bytes/4;
+    }
+    
+    /*element type from the index or the letters before the trailing "__":
+        the data are copied unchanged so the byte order is that of this
+        machine*/
+    n = 1;
+    descr[0] = ( *(char *)&n == 1 ) ? '<' : '>';
+    if (layidx.mxsp > 0) strcpy(type, layidx.type);
+    else mspec_type(name, type);
+    if (toupper(type[0]) == 'F') strcpy(descr+1, "f4");
+    else sprintf(descr+1, "%c%d", toupper(type[0]) == 'U' ? 'u' : 'i', sz);
+    
+    if ( (fd = open(name, O_RDONLY)) < 0)
+    {
+    	printf("Cannot open file: %s \n", name);
+	return -1;
+    }
+    fsz = bytes;
+    if ( (data = (char *) mmap(NULL, fsz, PROT_READ, MAP_PRIVATE, fd, 0))
+            == MAP_FAILED)
+    {
+    	printf("Cannot map file: %s \n", name);
+        close(fd);
+	return -1;
+    }
+    madvise(data, fsz, MADV_SEQUENTIAL);
+    /*written as outname.tmp, renamed only when complete*/
+    snprintf(tmp, sizeof(tmp), "%s.tmp", outname);
+    if ( (fo = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0666)) < 0)
+    {
+    	printf("Cannot open file: %s \n", outname);
+        munmap(data, fsz);
+        close(fd);
+	return -1;
+    }
+    
+    /*header then the mapped spectra in a single pass*/
+    n = npy_header(hdr, descr, mxsp, numch);
+    k = write(fo, hdr, n);
+    bytes = (long)mxsp*numch*sz;
+    for (w = 0; k == n && w < bytes; w += k)
+        if ( (k = write(fo, data + w, bytes - w)) <= 0) break;
+    munmap(data, fsz);
+    close(fd);
+    if (close(fo) < 0) w = -1;
+    if (w < bytes || rename(tmp, outname) < 0)
+    {
+    	printf("Error writing file: %s \n", outname);
+        unlink(tmp);
+	return -1;
+    }
+    printf(" %s ==> %s %d x %d (%s)\n", name, outname, mxsp, numch, descr);
+    return 0;
+} /*END npy_mspec()*/
+
+/*==========================================================================*/
+/* npy_write: write spectrum as a 1D float32 NumPy .npy array               */
+/****************************************************************************/
+void npy_write(char name[], int numch)
+{
+    int     n;
+    char    hdr[256];
+    FILE    *fsp;
+    
+    if ( (fsp = spec_open(name, "w" )) == NULL)
+    {
+    	printf("Cannot open file: %s \n", name);
+	return ; 
+    }
+    n = 1;
+    n = npy_header(hdr, ( *(char *)&n == 1 ) ? "<f4" : ">f4", 0, numch);
+    fwrite(hdr, n, 1, fsp);
+    fwrite(spectrum, numch*sizeof(float), 1, fsp);
+    
+    printf(" ==> %s %d chs.\n", name, numch);
+    spec_close(fsp);
+} /*END npy_write()*/
+
+/*==========================================================================*/
+/* num_fname: create numbered filenames	    	    	    	    	    */
+/****************************************************************************/
+void num_fname(char name[], int num)
+{
+    int i = 0, j, len;
+    char ans[MXNUMDIG+1] = "", buf[MXNUMDIG+3] = "";
+    
+    len = strlen(name);
+    strncpy(buf+i++, "_", 1);
+    itoa(num, ans);
+    
+    /*add zeroes to pad out file name if num is less than the maximum
+        number of digits*/
+    for (j = 0; j < (MXNUMDIG - (int)strlen(ans)); j++)
+        strncpy(buf+i++, "0", 1);
+    
+    strncpy(buf+i, ans, (int)strlen(ans));
+    i += (int)strlen(ans);
+    strncpy(buf+i++, ".", 1);
+    buf[i] = '\0';
+    if ( (strrchr(name,'.')) )
+	strncpy( (strrchr(name,'.')), buf, i);
+    else strncat(name, buf, i);
+    
+    /*length without ext.*/
+    i = strrchr(name,'.') - &name[0];
+    for (j = 1; j < (len - i); j++) name[i+j] = (char)0;
+    
+    return;
+} /*END num_fname()*/
+
+/*==========================================================================*/
+/* probe_chn: decode Maestro .Chn header and trailer using positioned reads */
+/****************************************************************************/
+int probe_chn(int fd, long size, struct specmeta *m)
+{
+    struct  maest_header h;
+    struct  maest_trailer t;
+    int     ch;
+    
+    if (pread(fd, &h, sizeof(h), 0) != sizeof(h) || h.q1 != -1) return -1;
+    
+    /*channels stored by the other byte order*/
+    ch = (unsigned short)h.channels;
+    if (ch < 1 || ch > CHMAX)
+    {
+        swapb2( (char *) &h.channels );
+        swapb2( (char *) &h.off );
+        swapb4( (char *) &h.real );
+        swapb4( (char *) &h.lve );
+        ch = (unsigned short)h.channels;
+        if (ch < 1 || ch > CHMAX) return -1;
+    }
+    m->channels = ch;
+    m->off = h.off;
+    m->real = h.real*0.02;
+    m->live = h.lve*0.02;
+    /*DDMMMYY* ==> DDMMMYYYY (year 2000+ if * is 1)*/
+    memcpy(m->date, h.dt, 5);
+    memcpy(m->date+5, h.dt[7] == '1' ? "20" : "19", 2);
+    memcpy(m->date+7, h.dt+5, 2);
+    m->date[9] = '\0';
+    snprintf(m->time, sizeof(m->time), "%c%c:%c%c:%c%c", h.sttm[0], h.sttm[1],
+            h.sttm[2], h.sttm[3], ((char *)&h.q4)[0], ((char *)&h.q4)[1]);
+    
+    /*trailer (tag -102, or 102/-101) follows the 4 byte/channel data*/
+    if (size >= (long)(sizeof(h) + 4*ch + 16)
+        && pread(fd, &t, 16, sizeof(h) + 4*ch) == 16
+        && (abs(t.t1) == 102 || t.t1 == -101))
+    {
+        m->cal[0] = t.g[0];
+        m->cal[1] = t.g[1];
+        m->cal[2] = t.g[2];
+    }
+    return 0;
+} /*END probe_chn()*/
+
+/*==========================================================================*/
+/* probe_file: open a spectrum and decode its header (sniffed format)       */
+/****************************************************************************/
+int probe_file(char name[], struct specmeta *m)
+{
+    int     fd, i;
+    struct  stat statbuf;
+    
+    m->live = m->real = -1.0;
+    m->channels = -1;
+    if ( (fd = open(name, O_RDONLY)) < 0)
+    {
+        m->err = 1;
+        return -1;
+    }
+    fstat(fd, &statbuf);
+    
+    i = sniff_fmt(name);
+    if (i > 0) strcpy(m->fmt, fmti[i-1]);
+    else strcpy(m->fmt, "Unknown");
+    if (i == 4) m->err = probe_chn(fd, (long)statbuf.st_size, m);
+    else if (i == 9) m->err = probe_spe(fd, (long)statbuf.st_size, m);
+    else if (i == 1) m->err = probe_rad(fd, (long)statbuf.st_size, m);
+    else m->err = -1;
+    close(fd);
+    return m->err;
+} /*END probe_file()*/
+
+/*==========================================================================*/
+/* probe_rad: decode RadWare .spe header using a positioned read            */
+/****************************************************************************/
+int probe_rad(int fd, long size, struct specmeta *m)
+{
+    int     i;
+    struct  radheader h;
+    
+    if (pread(fd, &h, sizeof(h), 0) != sizeof(h)) return -1;
+    if (h.q1 != 24)
+    {
+        swapb4( (char *) &h.q1 );
+        swapb4( (char *) &h.channels );
+    }
+    if (h.q1 != 24 || h.channels < 1 || h.channels > CHMAX) return -1;
+    m->channels = h.channels;
+    memcpy(m->name, h.name, 8);
+    /*remove space padding*/
+    for (m->name[8] = '\0', i = 7; i >= 0 && m->name[i] == ' '; i--)
+        m->name[i] = '\0';
+    return 0;
+} /*END probe_rad()*/
+
+/*==========================================================================*/
+/* probe_spe: decode Maestro .Spe header and trailer sections               */
+/****************************************************************************/
+int probe_spe(int fd, long size, struct specmeta *m)
+{
+    int     i, lo = 0, hi = -1;
+    long    n, pos;
+    char    buf[16384], *p;
+    
+    /*header sections are all before $DATA*/
+    n = size < (long)sizeof(buf)-1 ? size : (long)sizeof(buf)-1;
+    if ( (n = pread(fd, buf, n, 0)) <= 0) return -1;
+    buf[n] = '\0';
+    if (strncmp(buf, "$SPEC_ID", 8)) return -1;
+    
+    if ( (p = strstr(buf, "\n$DATE_MEA")) && (p = strchr(p+1, '\n')) )
+        sscanf(p+1, "%11s %9s", m->date, m->time);
+    if ( (p = strstr(buf, "\n$MEAS_TIM")) && (p = strchr(p+1, '\n')) )
+        sscanf(p+1, "%f %f", &m->live, &m->real);
+    if ( (p = strstr(buf, "\n$DATA")) && (p = strchr(p+1, '\n')) )
+    {
+        sscanf(p+1, "%d %d", &lo, &hi);
+        m->off = lo;
+        m->channels = hi - lo + 1;
+    }
+    
+    /*calibration is in the trailer after the data, read the file tail*/
+    pos = size > (long)sizeof(buf)-1 ? size - (long)sizeof(buf) + 1 : 0;
+    if ( (n = pread(fd, buf, size - pos, pos)) <= 0) return -1;
+    buf[n] = '\0';
+    /*the data may contain '\0' only if the file is corrupt, skip over it*/
+    for (i = 0; i < n; i++) if (buf[i] == '\0') buf[i] = ' ';
+    if ( (p = strstr(buf, "\n$MCA_CAL")) && (p = strchr(p+1, '\n'))
+            && (p = strchr(p+1, '\n')) )
+        sscanf(p+1, "%f %f %f", &m->cal[0], &m->cal[1], &m->cal[2]);
+    return m->channels > 0 ? 0 : -1;
+} /*END probe_spe()*/
+
+/*==========================================================================*/
+/* probe_thread: probe files taken from a shared probejob until done        */
+/****************************************************************************/
+void *probe_thread(void *arg)
+{
+    struct  probejob *job = (struct probejob *)arg;
+    int     i;
+    
+    while ( (i = __atomic_fetch_add(&job->next, 1, __ATOMIC_RELAXED)) < job->n)
+        probe_file(job->names[i], &job->meta[i]);
+    return NULL;
+} /*END probe_thread()*/
+
+/*==========================================================================*/
+/* proc_stages: processing between read and write: -c rebinning, the -A    */
+/*              expression then the -B background. Returns the channels   */
+/*              to write, -1 if nothing is to be written                  */
+/****************************************************************************/
+int proc_stages(char name[], int numch, int md, int of)
+{
+    extern float spectrum[CHMAX];
+    static int busy = 0;
+    float   y[CHMAX];
+    int     n;
+    
+    /*side outputs (background, errors) go through the writers unchanged*/
+    if (busy) return numch;
+    busy = 1;
+    if (rbfac > 1 || rbg[1] != 0.0)
+    {
+        n = rebin(spectrum, y, numch);
+        memcpy(spectrum, y, n*sizeof(float));
+        if (n < numch) memset(spectrum + n, 0, (numch - n)*sizeof(float));
+        numch = n;
+        /*calibration and ROIs of the new channels: old channel j is at
+            A0 + A1 j (j/n when compressing), not invertible if quadratic*/
+        if (rbfac > 1)
+        {
+            meta.cal[1] *= rbfac;
+            meta.cal[2] *= (float)rbfac*rbfac;
+            meta.fit[1] *= rbfac;
+            for (n = 0; n < meta.nroi; n++)
+            {
+                meta.roi[n][0] /= rbfac;
+                meta.roi[n][1] /= rbfac;
+            }
+        }
+        else if (rbg[2] == 0.0)
+        {
+            meta.cal[0] += (-meta.cal[1] + meta.cal[2]*rbg[0]/rbg[1])*rbg[0]/rbg[1];
+            meta.cal[1] = (meta.cal[1] - 2.0*meta.cal[2]*rbg[0]/rbg[1])/rbg[1];
+            meta.cal[2] /= rbg[1]*rbg[1];
+            meta.fit[0] -= meta.fit[1]*rbg[0]/rbg[1];
+            meta.fit[1] /= rbg[1];
+            for (n = 0; n < meta.nroi; n++)
+            {
+                meta.roi[n][0] = (int)(rbg[0] + rbg[1]*meta.roi[n][0]);
+                meta.roi[n][1] = (int)(rbg[0] + rbg[1]*meta.roi[n][1]);
+            }
+        }
+        else
+        {
+            memset(meta.cal, 0, sizeof(meta.cal));
+            memset(meta.fit, 0, sizeof(meta.fit));
+            meta.nroi = 0;
+        }
+        meta.channels = numch;
+    }
+    if (strlen(aropt) && ar_stage(name, numch, md, of) < 0)
+    {
+        printf("%s not written\n", name);
+        numch = -1;
+    }
+    if (numch > 0 && bgit > 0) bg_stage(name, numch, md, of);
+    busy = 0;
+    return numch;
+} /*END proc_stages()*/
+
+/*==========================================================================*/
+/* out_claim: claim output name for this run, -1 if another input has it   */
+/****************************************************************************/
+int out_claim(char name[])
+{
+    int     i, n;
+    unsigned long long h = 14695981039346656037ULL, v;
+    char    *p;
+    
+    if (oclaim == NULL) return 0;
+    for (p = name; *p != '\0'; p++) h = (h ^ (unsigned char)*p)*1099511628211ULL;
+    if (h == 0) h = 1;
+    /*open addressing: a free slot is taken by one process only*/
+    for (i = h % NCLAIM, n = 0; n < NCLAIM; n++, i = (i + 1) % NCLAIM)
+    {
+        if ( (v = __sync_val_compare_and_swap(&oclaim[i], 0, h)) == 0)
+            return 0;
+        if (v == h) return -1;
+    }
+    return 0;
+} /*END out_claim()*/
+
+/*==========================================================================*/
+/* out_close: close an output file, renaming name.tmp to name               */
+/****************************************************************************/
+int out_close(FILE *fp)
+{
+    int     i, rc;
+    char    tmp[CHLEN+12];
+    
+    for (i = 0; i < NTMPO && tmpout.fp[i] != fp; i++) ;
+    /*a short write must not replace a complete older file*/
+    rc = ferror(fp) ? EOF : 0;
+    if (fclose(fp) != 0) rc = EOF;
+    if (i == NTMPO) return rc;
+    tmpout.fp[i] = NULL;
+    sprintf(tmp, "%s.tmp", tmpout.name[i]);
+    if (rc != 0) unlink(tmp);
+    else if ( (rc = rename(tmp, tmpout.name[i])) != 0)
+        printf("Cannot rename %s to %s\n", tmp, tmpout.name[i]);
+    return rc;
+} /*END out_close()*/
+
+/*==========================================================================*/
+/* out_fail: report output name that could not be written as a failure of  */
+/*           list entry entry (name itself if there is none); the caller    */
+/*           counts it                                                      */
+/****************************************************************************/
+void out_fail(char name[], char entry[])
+{
+    char    why[CHLEN+16];
+    
+    snprintf(why, sizeof(why), "cannot write %s", name);
+    fail_report(strlen(entry) ? entry : name, why);
+} /*END out_fail()*/
+
+/*==========================================================================*/
+/* out_open: open output file name as name.tmp (appending as name itself)  */
+/****************************************************************************/
+FILE *out_open(char name[], char mode[])
+{
+    int     i;
+    char    tmp[CHLEN+12];
+    FILE    *fp;
+    
+    for (i = 0; i < NTMPO && tmpout.fp[i] != NULL; i++) ;
+    if (mode[0] != 'w' || i == NTMPO || strlen(name) >= CHLEN+8)
+        return fopen(name, mode);
+    sprintf(tmp, "%s.tmp", name);
+    if ( (fp = fopen(tmp, mode)) != NULL)
+    {
+        tmpout.fp[i] = fp;
+        strcpy(tmpout.name[i], name);
+    }
+    return fp;
+} /*END out_open()*/
+
+/*==========================================================================*/
+/* par_fork: fork nw-1 worker processes, return worker number (0 = parent)  */
+/*           and set nw to the number of processes actually running         */
+/****************************************************************************/
+pid_t wpid[MXTHR];
+int par_fork(int *nw)
+{
+    int     w, n, fd[2];
+    pid_t   pid;
+    
+    /*flush so buffered output is not duplicated in each worker*/
+    fflush(stdout);
+    if (*nw > MXTHR) *nw = MXTHR;
+    if (*nw < 2 || pipe(fd) < 0)
+    {
+        *nw = 1;
+        return 0;
+    }
+    for (w = 1; w < *nw; w++)
+    {
+        if ( (pid = fork()) == 0)
+        {
+            /*work is shared out in strides of the number of processes,
+                known once all are forked*/
+            close(fd[1]);
+            if (read(fd[0], &n, sizeof(int)) != sizeof(int)) _exit(0);
+            close(fd[0]);
+            *nw = n;
+            return w;
+        }
+        if (pid < 0)
+        {
+            printf("Cannot start worker process ...using %d\n", w);
+            break;
+        }
+        wpid[w] = pid;
+    }
+    *nw = w;
+    close(fd[0]);
+    for (n = 1; n < w; n++) if (write(fd[1], &w, sizeof(int)) < 0) ;
+    close(fd[1]);
+    return 0;
+} /*END par_fork()*/
+
+/*==========================================================================*/
+/* par_wait: end worker w with status, parent returns sum of all statuses   */
+/****************************************************************************/
+int par_wait(int w, int status)
+{
+    int     i, st;
+    
+    fflush(stdout);
+    if (w > 0) _exit(status > 255 ? 255 : status);
+    for (i = 1; i < MXTHR; i++)
+    {
+        if (wpid[i] > 0 && waitpid(wpid[i], &st, 0) == wpid[i])
+        {
+            if (WIFEXITED(st)) status += WEXITSTATUS(st);
+            else status++;
+        }
+        wpid[i] = 0;
+    }
+    return status;
+} /*END par_wait()*/
+
+/*==========================================================================*/
+/* pipe_read: prefetch thread, reads upcoming list entries into slots       */
+/****************************************************************************/
+void *pipe_read(void *arg)
+{
+    struct  pipeline *p = (struct pipeline *)arg;
+    struct  pfslot *sl;
+    struct  stat statbuf;
+    long    n;
+    int     fd;
+    
+    pthread_mutex_lock(&p->mx);
+    while (p->run && p->next < p->n)
+    {
+        if (p->cnt == NPREF)
+        {
+            pthread_cond_wait(&p->cv, &p->mx);
+            continue;
+        }
+        sl = &p->slot[(p->head + p->cnt)%NPREF];
+        strncpy(sl->name, p->names[p->next], CHLEN-1);
+        sl->state = 0;
+        sl->len = 0;
+        p->next += p->nw;
+        p->cnt++;
+        pthread_mutex_unlock(&p->mx);
+        
+        /*read whole file into the slot buffer, growing it if needed*/
+        fd = open(sl->name, O_RDONLY);
+        if (fd >= 0 && fstat(fd, &statbuf) == 0 && statbuf.st_size > 0
+            && statbuf.st_size <= PFMAX)
+        {
+            if (statbuf.st_size > sl->cap)
+            {
+                free(sl->buf);
+                sl->buf = (char *) malloc(statbuf.st_size);
+                sl->cap = sl->buf ? statbuf.st_size : 0;
+            }
+            if (sl->buf) for (sl->len = 0; sl->len < statbuf.st_size;
+                    sl->len += n)
+                if ( (n = pread(fd, sl->buf + sl->len,
+                        statbuf.st_size - sl->len, sl->len)) <= 0) break;
+        }
+        if (fd >= 0) close(fd);
+        
+        pthread_mutex_lock(&p->mx);
+        sl->state = (sl->buf && fd >= 0 && sl->len > 0
+                && sl->len == (long)statbuf.st_size) ? 1 : 2;
+        pthread_cond_broadcast(&p->cv);
+    }
+    pthread_mutex_unlock(&p->mx);
+    return NULL;
+} /*END pipe_read()*/
+
+/*==========================================================================*/
+/* pipe_start: start prefetch and writer threads for list entries w+i*nw    */
+/****************************************************************************/
+void pipe_start(char **names, int n, int w, int nw, int own)
+{
+    static int reg = 0;
+    int     i;
+    
+    if (pipeline.run) pipe_stop();
+    pipeline.names = names;
+    pipeline.n = n;
+    pipeline.nw = nw;
+    /*a channel window (-w) is read by positioned reads of just the window,
+        so whole files are not prefetched*/
+    pipeline.next = (whi >= 0) ? n : w;
+    pipeline.own = own;
+    pipeline.head = 0;
+    pipeline.cnt = 0;
+    pipeline.cur = -1;
+    pipeline.ocnt = 0;
+    pipeline.wfail = 0;
+    for (i = 0; i < NOBUF; i++)
+    {
+        pipeline.ofp[i] = NULL;
+        pipeline.olen[i] = -1;
+    }
+    pthread_mutex_init(&pipeline.mx, NULL);
+    pthread_cond_init(&pipeline.cv, NULL);
+    pipeline.run = 1;
+    if (pthread_create(&pipeline.rt, NULL, pipe_read, &pipeline) != 0)
+    {
+        pipeline.run = 0;
+        return ;
+    }
+    if (pthread_create(&pipeline.wt, NULL, pipe_write, &pipeline) != 0)
+    {
+        pipe_stop();
+        return ;
+    }
+    /*queued output must be written however the program exits*/
+    if (! reg) reg = (atexit(pipe_stop) == 0);
+} /*END pipe_start()*/
+
+/*==========================================================================*/
+/* pipe_stop: stop prefetching and wait for queued output to be written     */
+/****************************************************************************/
+void pipe_stop(void)
+{
+    int     i;
+    
+    if (! pipeline.run) return ;
+    pthread_mutex_lock(&pipeline.mx);
+    pipeline.run = 0;
+    pthread_cond_broadcast(&pipeline.cv);
+    pthread_mutex_unlock(&pipeline.mx);
+    pthread_join(pipeline.rt, NULL);
+    pthread_join(pipeline.wt, NULL);
+    /*counted here, not as they happen, so that they do not look like
+        failures of the entry being converted at the time*/
+    nfail += pipeline.wfail;
+    pipeline.wfail = 0;
+    
+    /*buffers are kept for the next pipeline*/
+    pipeline.cnt = 0;
+    pipeline.cur = -1;
+    if (pipeline.own)
+    {
+        for (i = 0; i < pipeline.n; i++) free(pipeline.names[i]);
+        free(pipeline.names);
+    }
+    pipeline.names = NULL;
+} /*END pipe_stop()*/
+
+/*==========================================================================*/
+/* pipe_write: writer thread, writes queued output buffers in batches       */
+/****************************************************************************/
+void *pipe_write(void *arg)
+{
+    struct  pipeline *p = (struct pipeline *)arg;
+    int     i, n, fd, q[NOBUF];
+    long    w, k;
+    char    tmp[CHLEN+4], bad[CHLEN] = "";
+    
+    pthread_mutex_lock(&p->mx);
+    while (p->run || p->ocnt > 0)
+    {
+        if (p->ocnt == 0)
+        {
+            pthread_cond_wait(&p->cv, &p->mx);
+            continue;
+        }
+        /*take every queued buffer*/
+        for (i = 0, n = p->ocnt; i < n; i++) q[i] = p->oq[i];
+        p->ocnt = 0;
+        pthread_mutex_unlock(&p->mx);
+        
+        /*files are replaced by renaming name.tmp (journal lines are
+            appended), in queue order, so the journal line of an entry
+            comes after its outputs and is dropped if one of them failed*/
+        for (i = 0; i < n; i++)
+        {
+            if (p->omode[q[i]] == 'a' && strlen(bad)
+                && ! strcmp(p->oname[q[i]], journal.name)
+                && ! strcmp(p->oent[q[i]], bad)) continue;
+            if (p->omode[q[i]] == 'a') strcpy(tmp, p->oname[q[i]]);
+            else sprintf(tmp, "%s.tmp", p->oname[q[i]]);
+            if ( (fd = open(tmp, O_WRONLY | O_CREAT | (p->omode[q[i]] == 'a'
+                    ? O_APPEND : O_TRUNC), 0666)) < 0) w = -1;
+            else
+            {
+                for (w = 0; w < p->olen[q[i]]; w += k)
+                    if ( (k = write(fd, p->obuf[q[i]] + w,
+                            p->olen[q[i]] - w)) <= 0) break;
+                if (close(fd) < 0) w = -1;
+            }
+            if (p->omode[q[i]] != 'a' && fd >= 0 && (w < p->olen[q[i]]
+                    || rename(tmp, p->oname[q[i]]) != 0))
+            {
+                unlink(tmp);
+                w = -1;
+            }
+            if (w < p->olen[q[i]])
+            {
+                p->wfail++;
+                out_fail(p->oname[q[i]], p->oent[q[i]]);
+                strcpy(bad, p->oent[q[i]]);
+            }
+        }
+        
+        pthread_mutex_lock(&p->mx);
+        for (i = 0; i < n; i++) p->olen[q[i]] = -1;
+        pthread_cond_broadcast(&p->cv);
+    }
+    pthread_mutex_unlock(&p->mx);
+    return NULL;
+} /*END pipe_write()*/
+
+/*==========================================================================*/
+/* put_opts: put the batch options as '\0' terminated arguments into req,   */
+/*           return the bytes used                                          */
+/****************************************************************************/
+int put_opts(char req[])
+{
+    extern float gain[3];
+    extern int  md, ofmt, ovwr;
+    extern char outopt[CHLEN], layopt[CHLEN], stname[CHLEN], roiopt[CHLEN];
+    int     i, len = 0;
+    
+    len += sprintf(req + len, "-m%c", MODECH[md]) + 1;
+    len += sprintf(req + len, "-f%d", ofmt + 1) + 1;
+    if (strlen(outopt)) len += sprintf(req + len, "-o%s", outopt) + 1;
+    if (strlen(layopt)) len += sprintf(req + len, "-L%s", layopt) + 1;
+    if (strlen(roiopt)) len += sprintf(req + len, "-R%s", roiopt) + 1;
+    if (gain[0] != 0.0 || gain[1] != 0.0 || gain[2] != 0.0)
+        len += sprintf(req + len, "-g%g,%g,%g", gain[0], gain[1], gain[2]) + 1;
+    if (whi >= 0) len += sprintf(req + len, "-w%d-%d", wlo, whi) + 1;
+    if (strlen(stname)) len += sprintf(req + len, "-s%s", stname) + 1;
+    if (rbfac > 1) len += sprintf(req + len, "-c%d", rbfac) + 1;
+    else if (rbg[1] != 0.0)
+        len += sprintf(req + len, "-c%g,%g,%g", rbg[0], rbg[1], rbg[2]) + 1;
+    if (strlen(aropt)) len += sprintf(req + len, "-A%s", aropt) + 1;
+    if (arerr) len += sprintf(req + len, "-E") + 1;
+    if (bgit > 0) len += sprintf(req + len, "-B%d,%d", bgit, bgwin) + 1;
+    if (bglls) len += sprintf(req + len, "-T") + 1;
+    if (bgout) len += sprintf(req + len, "-K") + 1;
+    if (pyrout) len += sprintf(req + len, "-P") + 1;
+    if (! metaout) len += sprintf(req + len, "-N") + 1;
+    if (strlen(failopt)) len += sprintf(req + len, "-F%s", failopt) + 1;
+    if (strlen(walkflt)) len += sprintf(req + len, "-I%s", walkflt) + 1;
+    for (i = 0; i < nstw; i++)
+        len += sprintf(req + len, "%s%d-%d", i ? "," : "-W", stw[i][0],
+                stw[i][1]) + (i == nstw - 1);
+    if (ovwr) len += sprintf(req + len, "-y") + 1;
+    return len;
+} /*END put_opts()*/
+
+/*==========================================================================*/
+/* pyr_write: write sidecar "name.pyr" with the min, max and sum of bins of */
+/*            2, 4, 8 ... channels, down to one bin for the whole spectrum  */
+/****************************************************************************/
+int pyr_write(char name[], int numch)
+{
+    extern float spectrum[CHMAX];
+    float   *buf, *mn, *mx, *sm, *pmn, *pmx, *psm;
+    int     i, l, n, nb, nlev, tot, lev[2*MXPYR];
+    char    pname[CHLEN+5];
+    FILE    *fp;
+    
+    /*"SPECPYR", channels, levels, then bins and byte offset of each level;
+        a level is its nb minima, nb maxima then nb sums as floats*/
+    for (n = numch, nlev = 0, tot = 0; n > 1 && nlev < MXPYR; nlev++)
+    {
+        n = (n + 1)/2;
+        lev[2*nlev] = n;
+        lev[2*nlev+1] = 16 + 8*MXPYR + 12*tot;
+        tot += n;
+    }
+    if (nlev == 0) return 0;
+    for (i = nlev; i < MXPYR; i++) lev[2*i] = lev[2*i+1] = 0;
+    if ( (buf = (float *) malloc(3*tot*sizeof(float))) == NULL) return -1;
+    
+    /*each level from the one below (level 0 is the spectrum)*/
+    pmn = pmx = psm = spectrum;
+    for (l = 0, n = numch, mn = buf; l < nlev; l++)
+    {
+        nb = lev[2*l];
+        mx = mn + nb;
+        sm = mx + nb;
+        for (i = 0; i < n/2; i++)
+        {
+            mn[i] = pmn[2*i] < pmn[2*i+1] ? pmn[2*i] : pmn[2*i+1];
+            mx[i] = pmx[2*i] > pmx[2*i+1] ? pmx[2*i] : pmx[2*i+1];
+            sm[i] = psm[2*i] + psm[2*i+1];
+        }
+        if (n%2)
+        {
+            mn[nb-1] = pmn[n-1];
+            mx[nb-1] = pmx[n-1];
+            sm[nb-1] = psm[n-1];
+        }
+        pmn = mn;
+        pmx = mx;
+        psm = sm;
+        mn = sm + nb;
+        n = nb;
+    }
+    
+    sprintf(pname, "%s.pyr", name);
+    if ( (fp = spec_open(pname, "w")) == NULL)
+    {
+        printf("Cannot open file: %s \n", pname);
+        free(buf);
+        return -1;
+    }
+    fwrite("SPECPYR", 8, 1, fp);
+    fwrite(&numch, sizeof(int), 1, fp);
+    fwrite(&nlev, sizeof(int), 1, fp);
+    fwrite(lev, sizeof(int), 2*MXPYR, fp);
+    fwrite(buf, sizeof(float), 3*tot, fp);
+    spec_close(fp);
+    free(buf);
+    return 0;
+} /*END pyr_write()*/
+
+/*===========================================================================*/
+/* rad_read: read the radware format spectrum */
+/*****************************************************************************/
+int rad_read(char name[])
+{
+    float *counts;
+    int i = 0;
+    FILE *fsp;
+        
+    /*opens read only RadWare file*/
+    if ( (fsp = spec_open(name, "r")) == NULL)
+    {
+    	printf("Cannot open file: %s\n", name);
+	return -1;
+    }
+    
+    /*clear the header*/
+    memset(&radheader, 0, sizeof(radheader));
+    /*construct radware header*/
+    fread(&radheader, sizeof(radheader), 1, fsp);
+        
+/*    printf(" radheader.channels = %d\n radheader.q1 = %d \n"
+	   " radheader.q3 = %d\n radheader.q4 = %d \n"
+	   " radheader.q5 = %d\n radheader.size = %d \n",
+	    radheader.channels, radheader.q1, radheader.q3,
+	    radheader.q4, radheader.q5, radheader.size);*/
+       
+    /*unix byte swapping option*/
+    if (radheader.channels > CHMAX && cswap4(radheader.channels) > CHMAX )
+    {
+    	printf("Unrecognised format. Exiting.....\n");
+	spec_close(fsp);
+    	return -1;
+    }
+    if (radheader.channels > CHMAX)
+    {
+	/*swap the bytes in the headers*/
+    	radheader.channels = cswap4(radheader.channels);
+	radheader.q1 = cswap4(radheader.q1);
+	radheader.q2 = cswap4(radheader.q2);
+    	radheader.q3 = cswap4(radheader.q3);
+    	radheader.q4 = cswap4(radheader.q4);
+    	radheader.q5 = cswap4(radheader.q5);
+	radheader.size = cswap4(radheader.size);
+		
+	printf(".......SWAPPING BYTES read from file.......\n");
+    	/*allocate sufficient memory for spectrum*/
+    	counts = (float *) malloc( radheader.channels*sizeof(float) );
+	
+    	/*read the data*/
+	fread(counts, radheader.size, 1, fsp);
+	/*read the trailer*/
+	fread(&radtrailer.size, 4, 1, fsp);
+	radtrailer.size = cswap4(radtrailer.size);
+    	
+    	/*fill spectrum array*/
+    	for (i = 0; i < (int) radheader.channels; i++)
+	    swapb4( (char *) (counts + i) );	
+    }
+    /*end of byte swapping loop for unix*/    
+    else
+    {
+    	/*allocate sufficient memory for spectrum*/
+    	counts = (float *) malloc( radheader.channels*sizeof(float) );
+	/*read the data*/
+	fread(counts, radheader.size, 1, fsp);
+	/*read the trailer*/
+	fread(&radtrailer.size, 4, 1, fsp);    
+    }
+    /*fill spectrum array*/
+    for (i = 0; i < radheader.channels; i++)
+    	spectrum[i] = (float)*(counts + i);
+    
+    /*the 8 character name is kept (without space padding)*/
+    strcpy(meta.fmt, "RadWare");
+    memcpy(meta.name, radheader.name, 8);
+    for (meta.name[8] = '\0', i = 7; i >= 0 && meta.name[i] == ' '; i--)
+        meta.name[i] = '\0';
+    
+    free(counts);
+    spec_close(fsp);
+    return radheader.channels;
+} /*END rad_read()*/
+
+/*==========================================================================*/
+/* rad_write: prepare and write the radware format spectrum      	    */
+/****************************************************************************/
+void rad_write(char name[], int numch)
+{
+    int     j;
+    FILE    *fsp;
+        
+    /*open .spe write only file*/
+    if ( (fsp = spec_open(name, "w" )) == NULL)
+    {
+    	printf("Cannot open file: %s \n", name);
+	return ; 
+    } 	    	    
+    	  
+    /*clear the header*/
+    memset(&radheader, 0, sizeof(radheader));
+    /*clear the trailer*/
+    memset(&radtrailer, 0, sizeof(radtrailer));
+    
+    /*construct radware header*/
+    radheader.q1 = 24;
+    
+    /*name read from a RadWare spectrum, else the file name*/
+    if (strlen(meta.name))
+    {
+        j = strlen(meta.name);
+        memcpy(radheader.name, meta.name, j);
+    }
+    else
+    {
+        /*length without ext.*/
+        j = strrchr(name,'.') - &name[0];
+        /*copy max. 8 bytes to radheader.name*/
+        strncpy(radheader.name, name, 8);
+    }
+    /*set any extra characters so spaces*/
+    if (j < 8) memset(&radheader.name[j], ' ', 8-j);
+    
+    radheader.channels = numch;
+    radheader.q2 = 1;
+    radheader.q3 = 1;
+    radheader.q4 = 1;
+    radheader.q5 = 24;
+    radheader.size = numch * sizeof(float);
+    
+    radtrailer.size = numch * sizeof(float);
+  
+    fwrite(&radheader, sizeof(radheader), 1, fsp);
+    fwrite(spectrum, radheader.size, 1, fsp);
+    fwrite(&radtrailer, sizeof(float), 1, fsp);
+
+    printf(" ==> %s %d chs.\n", name, numch);
+    
+    spec_close(fsp);
+} /*END rad_write()*/
+
+/*==========================================================================*/
+/* raw_write: write raw float32 counts with a JSON sidecar describing them  */
+/****************************************************************************/
+int raw_write(char name[], int numch)
+{
+    int     n = 1;
+    char    jname[CHLEN+5];
+    FILE    *fsp;
+    
+    if ( (fsp = spec_open(name, "w" )) == NULL)
+    {
+    	printf("Cannot open file: %s \n", name);
+	return -1; 
+    }
+    fwrite(spectrum, numch*sizeof(float), 1, fsp);
+    spec_close(fsp);
+    
+    /*sidecar: name.f32 ==> name.f32.json*/
+    sprintf(jname, "%s.json", name);
+    if ( (fsp = spec_open(jname, "w" )) == NULL)
+    {
+    	printf("Cannot open file: %s \n", jname);
+	return -1; 
+    }
+    fprintf(fsp, "{\"format\": \"spec_conv raw columns\", \"data\": \"%s\",\n"
+            " \"rows\": %d, \"offset\": 0, \"first_channel\": 0,\n"
+            " \"columns\": [{\"name\": \"counts\", \"dtype\": \"%cf4\"}]",
+            strrchr(name,'/') ? strrchr(name,'/')+1 : name, numch,
+            ( *(char *)&n == 1 ) ? '<' : '>');
+    if (metaout && strlen(meta.fmt))
+    {
+        fprintf(fsp, ",\n \"meta\": ");
+        meta_json(fsp, meta.src, &meta, 1);
+    }
+    fprintf(fsp, "}\n");
+    spec_close(fsp);
+    
+    printf(" ==> %s (+.json) %d chs.\n", name, numch);
+    return 0;
+} /*END raw_write()*/
+
+/*==========================================================================*/
+/* read_any: read a spectrum of any (sniffed) format into spectrum[]        */
+/****************************************************************************/
+int read_any(char name[])
+{
+    int     i, mdo = md, numch;
+    struct  stat statbuf;
+    
+    if ( (md = sniff_fmt(name)) < 0)
+    {
+        printf("%s***Unrecognised format: %s%s\n",clr[1],name,clr[0]);
+        md = mdo;
+        return -1;
+    }
+    for (i = 0; i < CHMAX; i++) spectrum[i] = 0.0;
+    if (md == 6)
+    {
+        /*single Xtrack spectrum (multiple spectrum files need modes 6/7)*/
+        stat(name, &statbuf);
+        numch = statbuf.st_size/4 < CHMAX ? statbuf.st_size/4 : CHMAX;
+        xtrack_read(name, &numch, 1, 4, 0, 0);
+    }
+    else numch = read_spec(name, md);
+    md = mdo;
+    return numch;
+} /*END read_any()*/
+
+/*==========================================================================*/
+/* read_layout: read a list-mode layout descriptor file into lmlayout      */
+/****************************************************************************/
+int read_layout(char name[])
+{
+    int     i, c;
+    char    key[CHLEN] = "";
+    FILE    *fl;
+    
+    if ( (fl = fopen(name, "r")) == NULL)
+    {
+    	printf("Cannot open file: %s\n", name);
+	return -1;
+    }
+    /*defaults: 2 byte detector ID followed by 2 byte energy*/
+    memset(&lmlayout, 0, sizeof(lmlayout));
+    lmlayout.reclen = 4;
+    lmlayout.detsz = 2;
+    lmlayout.enoff = 2;
+    lmlayout.ensz = 2;
+    lmlayout.ndet = 1;
+    lmlayout.numch = CHMAX;
+    lmlayout.comp = 1;
+    
+    /*each line is: keyword value(s) [comment], lines starting # skipped*/
+    while (1)
+    {
+        skip_hash(fl);
+        if (fscanf(fl, "%s", key) != 1) break;
+        if (! strcmp(key, "reclen")) i = fscanf(fl, "%d", &lmlayout.reclen);
+        else if (! strcmp(key, "det"))
+            i = fscanf(fl, "%d %d", &lmlayout.detoff, &lmlayout.detsz);
+        else if (! strcmp(key, "energy"))
+            i = fscanf(fl, "%d %d", &lmlayout.enoff, &lmlayout.ensz);
+        else if (! strcmp(key, "ndet")) i = fscanf(fl, "%d", &lmlayout.ndet);
+        else if (! strcmp(key, "numch")) i = fscanf(fl, "%d", &lmlayout.numch);
+        else if (! strcmp(key, "comp")) i = fscanf(fl, "%d", &lmlayout.comp);
+        else if (! strcmp(key, "swap")) i = fscanf(fl, "%d", &lmlayout.swap);
+        else if (! strcmp(key, "header")) i = fscanf(fl, "%ld", &lmlayout.hdr);
+        else printf("Unknown layout keyword '%s' ignored\n", key);
+        /*skip rest of line*/
+        while ( (c = fgetc(fl)) != '\n' && c != EOF) ;
+    }
+    fclose(fl);
+    
+    i = (int)pow(10,MXNUMDIG) - 1;
+    if (lmlayout.reclen < 1 || lmlayout.comp < 1 || lmlayout.hdr < 0
+        || lmlayout.ndet < 1 || lmlayout.ndet > i+1
+        || lmlayout.numch < 1 || lmlayout.numch > CHMAX
+        || (lmlayout.detsz != 1 && lmlayout.detsz != 2 && lmlayout.detsz != 4)
+        || (lmlayout.ensz != 1 && lmlayout.ensz != 2 && lmlayout.ensz != 4
+            && lmlayout.ensz != -4)
+        || lmlayout.detoff < 0 || lmlayout.detoff + lmlayout.detsz > lmlayout.reclen
+        || lmlayout.enoff < 0 || lmlayout.enoff + abs(lmlayout.ensz) > lmlayout.reclen)
+    {
+        printf("%s***Invalid list-mode layout in %s (max. %d detectors,"
+                " %d channels)%s\n",clr[1],name,i+1,CHMAX,clr[0]);
+        return -1;
+    }
+    printf("Layout: %d byte records, det. ID at %d (%d bytes), energy at %d"
+            " (%d bytes), %d detectors x %d channels%s\n",lmlayout.reclen,
+            lmlayout.detoff,lmlayout.detsz,lmlayout.enoff,lmlayout.ensz,
+            lmlayout.ndet,lmlayout.numch,lmlayout.swap ? ", byte swapped" : "");
+    return 0;
+} /*END read_layout()*/
+
+/*==========================================================================*/
+/* read_lst: read next spectrum name from list file, inname NULL forgets   */
+/*           a list left unfinished                                         */
+/****************************************************************************/
+int read_lst(char inname[], int lst)
+{
+    static int  fn = 0;
+    int         res, n = 0;
+    char        **names;
+    char        listname[CHLEN] = "";
+    static FILE *flst = NULL;
+    
+    if (inname == NULL)
+    {
+        if (flst != NULL) fclose(flst);
+        flst = NULL;
+        fn = 0;
+        return 0;
+    }
+    
+    /*open list file to read spec names*/
+    if (fn == 0 && lst == 1)
+    {
+        if (md == NUMOPT)
+    	    printf("Type filename containing list of spectrum file names"
+		    " and coefficients: \n");
+	else printf("Type filename containing list of spectrum file names:\n");
+	
+	get_line(listname, CHLEN);	
+    }
+    /*files found in directories rather than a list file*/
+    if (fn == 0 && walker.on)
+    {
+        strcpy(listname, WALKLST);
+        fail_open(listname);
+        jnl_open(listname);
+        pipe_start(NULL, 0, 0, 1, 0);
+    }
+    /*open file on first time in function*/
+    else if (fn == 0)
+    {
+        if (lst == -1) strcpy(listname,inname);
+    	if ((flst = fopen(listname, "r" )) == NULL)
+    	{
+    	    printf("Cannot open file: %s \n", listname);
+    	    return -1;			
+    	}
+        fail_open(listname);
+        jnl_open(listname);
+        /*prefetch the listed spectra (not yet converted) while earlier
+            ones are converted*/
+        if ( (names = load_lst(listname, &n)) != NULL)
+        {
+            jnl_filter(names, &n);
+            pipe_start(names, n, 0, 1, 1);
+        }
+    }
+    /*the previous entry is done*/
+    jnl_end();
+    
+    /*read and store ascii file names*/
+    /*skip comments lines starting with #, and entries of the journal*/
+    do
+    {
+        if (walker.on) res = walk_next(inname) == 0 ? 1 : EOF;
+        else res = get_entry(flst, inname, md == NUMOPT ? gain : NULL);
+    } while (res > 0 && jnl_skip(inname));
+    
+    switch (res)
+    {
+    	case 0:
+    	{
+    	    printf("Read error occurred for file: %s\n", listname);
+    	    fclose(flst);
+    	    flst = NULL;
+    	    fn = 0;
+    	    return -1;
+    	}
+    	case EOF:
+    	{
+    	    printf("\n\tRead %d spectrum names\n\n", fn);
+    	    if (flst != NULL) fclose(flst);
+    	    flst = NULL;
+    	    fn = 0;	    
+            /*wait for queued output to be written*/
+            pipe_stop();
+    	    return -1;
+    	}
+    	default:
+    	{
+    	    fn++;
+    	    printf("Read filename %d from list: %s\n",fn, inname);
+            jnl_begin(inname);
+	    return fn;
+    	}
+    }
+} /*END read_lst()*/
+
+/*==========================================================================*/
+/* read_spec: call appropriate spectrum_read function based on mode    	    */
+/****************************************************************************/
+int read_spec(char name[], int md)
+{
+    int i = 0;
+    
+    memset(&meta, 0, sizeof(meta));
+    meta.live = meta.real = -1.0;
+    strncpy(meta.src, name, CHLEN-1);
+    
+    /*sparse binary files are read whatever the mode; sniffed ones (mode 2)
+        are recognised by their header whatever their name*/
+    if ( (strrchr(name,'.') && ! strcmp(strrchr(name,'.'), oext[6]))
+        || (md == 2 && sp_magic(name)) )
+    {
+        if ( (i = sp_read(name)) > 0)
+        {
+            strcpy(meta.fmt, "Sparse");
+            meta.channels = i;
+            meta_read(name);
+        }
+        return i > 0 ? win_crop(i) : i;
+    }
+    
+    /*channel window: RadWare and Chn files read only the window*/
+    if (whi >= 0 && (md == 1 || md == 4 || md == 5 || md == NUMOPT)
+        && (i = win_read(name, md)) != 0) return i < 0 ? i : win_crop(i);
+    
+    if (md == 1) i = rad_read(name);
+    else if (md == 2) i = ascii_read(name);
+    else if (md == 3) i = ascii_read(name);
+    else if (md == 4) i = maestro_read(name);
+    else if (md == 5) i = maestro_read(name);
+    else if (md == 8) i = genie_read(name);
+    else if (md == 9) i = spe_read(name);
+    else if (md == 10) i = spe_read(name);
+    else if (md == NUMOPT) i = rad_read(name);
+    else return -1;
+    
+    if (i > 0)
+    {
+        if (! strlen(meta.fmt)) strcpy(meta.fmt, fmti[md-1]);
+        if (meta.channels == 0) meta.channels = i;
+        /*what the format cannot hold may be in a sidecar of ours*/
+        meta_read(name);
+    }
+    return i > 0 ? win_crop(i) : i;
+} /*END read_spec()*/
+
+/*==========================================================================*/
+/* rebin: rebin numch channels of in[] into out[] as set by -c, return the  */
+/*        number of channels of out[]                                      */
+/****************************************************************************/
+int rebin(float in[], float out[], int numch)
+{
+    float   c;
+    int     i, k, n;
+    
+    if (rbfac > 1)
+    {
+        /*sum of rbfac adjacent channels, in rbfac strided passes*/
+        n = (numch + rbfac - 1)/rbfac;
+        for (i = 0; i < n; i++) out[i] = 0.0;
+        for (k = 0; k < rbfac; k++)
+            for (i = 0; i < (numch - k + rbfac - 1)/rbfac; i++)
+                out[i] += in[i*rbfac + k];
+        return n;
+    }
+    
+    /*the last channel goes to c, split with c + 1 if c is fractional*/
+    c = rbg[0] + (numch - 1)*rbg[1] + (float)(numch - 1)*(numch - 1)*rbg[2];
+    n = c < CHMAX - 2 ? (int)c + 1 + (c > (int)c) : CHMAX;
+    if (n < 1) n = 1;
+    for (i = 0; i < n; i++) out[i] = 0.0;
+    rebin_map(in, out, numch, n, rbg, NULL, 0);
+    return n;
+} /*END rebin()*/
+
+/*==========================================================================*/
+/* rebin_map: add the counts of channel j of y[] to out[] (nout channels)   */
+/*            at A0 + A1 j + A2 j^2, split between the two channels it      */
+/*            overlaps. Only channels ch[0..nch) if ch is not NULL          */
+/****************************************************************************/
+void rebin_map(float y[], float out[], int numch, int nout, float g[],
+            int ch[], int nch)
+{
+    float   cal_chan, res;
+    int     i, j;
+    
+    for (i = 0; i < (ch ? nch : numch); i++)
+    {
+        j = ch ? ch[i] : i;
+        cal_chan = g[0] + j*g[1] + j*j*g[2];
+        /*do nothing with counts in channels out of range*/
+        if ( ( (int)cal_chan ) < 0 || ( (int)cal_chan ) >= nout) continue;
+        res =  cal_chan - (float)( (int)cal_chan );
+        out[(int)cal_chan] += y[j]*(1.0-res);
+        if ( ( (int)cal_chan ) + 1 < nout) out[((int)cal_chan) + 1] += y[j]*res;
+    }
+} /*END rebin_map()*/
+
+/*==========================================================================*/
+/* reverse: reverse string s in place	    	    	    	    	    */
+/****************************************************************************/
+void reverse(char s[])
+{
+    int c, i, j;
+
+    for (i = 0, j = strlen(s)-1; i < j; i++, j--)
+    {
+        c = s[i];
+        s[i] = s[j];
+        s[j] = c;
+    }
+} /*END reverse()*/
+
+/*==========================================================================*/
+/* roi_areas: gross and net areas of the ROIs of spectrum[] (numch         */
+/*  channels) in O(1) each from prefix sums, the background being linear    */
+/*  between the averages of 3 channels at each end of the ROI               */
+/****************************************************************************/
+int roi_areas(struct roires *r, int numch)
+{
+    static double p[CHMAX+1];
+    int     i, j, lo, hi, nb, nch, e[4];
+    double  bl, bh;
+    
+    /*p[i] = counts in channels 0..i-1, the same for i past numch*/
+    if (numch > CHMAX) numch = CHMAX;
+    p[0] = 0.0;
+    for (i = 0; i < numch; i++) p[i+1] = p[i] + spectrum[i];
+    
+    for (i = 0; i < r->nroi; i++)
+    {
+        lo = r->lo[i] < 0 ? 0 : r->lo[i];
+        hi = r->hi[i] >= CHMAX ? CHMAX - 1 : r->hi[i];
+        if (hi < lo) hi = lo;
+        nch = hi - lo + 1;
+        if ( (nb = nch/2) > 3) nb = 3;
+        if (nb < 1) nb = 1;
+        e[0] = lo;
+        e[1] = lo + nb;
+        e[2] = hi + 1 - nb;
+        e[3] = hi + 1;
+        for (j = 0; j < 4; j++) if (e[j] > numch) e[j] = numch;
+        r->gross[i] = p[e[3]] - p[e[0]];
+        bl = (p[e[1]] - p[e[0]])/nb;
+        bh = (p[e[3]] - p[e[2]])/nb;
+        r->bg[i] = 0.5*(bl + bh)*nch;
+        /*each end average has variance (counts/nb)/nb*/
+        r->err[i] = sqrt(r->gross[i] + 0.25*nch*nch*(bl + bh)/nb);
+    }
+    return 0;
+} /*END roi_areas()*/
+
+/*==========================================================================*/
+/* roi_file: read ROIs from a file of "first last" lines after any leading  */
+/*  "#" comment lines, return the number of ROIs, -1 if it cannot be opened */
+/****************************************************************************/
+int roi_file(char name[], int lo[], int hi[])
+{
+    int     n = 0;
+    FILE    *fp;
+    
+    if ( (fp = fopen(name, "r")) == NULL) return -1;
+    skip_hash(fp);
+    while (n < MXROI && fscanf(fp, "%d %d", &lo[n], &hi[n]) == 2) n++;
+    fclose(fp);
+    return n;
+} /*END roi_file()*/
+
+/*==========================================================================*/
+/* roi_table: integrate ROIs of n spectra in parallel and tabulate as CSV   */
+/****************************************************************************/
+int roi_table(char name[], char **names, int n, char roif[])
+{
+    int     i, j, w, nw, nu = 0, ulo[MXROI], uhi[MXROI], bmo = batch, numch;
+    char    q[2*CHLEN+3];
+    struct  roires *res;
+    FILE    *fp;
+    
+    if (strlen(roif) && (nu = roi_file(roif, ulo, uhi)) <= 0)
+    {
+        printf("No ROIs in file: %s \n", roif);
+        return -1;
+    }
+    /*results are shared so that the worker processes can fill them in*/
+    if ( (res = (struct roires *) mmap(NULL, n*sizeof(struct roires),
+            PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0))
+            == MAP_FAILED)
+    {
+        printf("Cannot allocate memory for %d spectra\n", n);
+        return -1;
+    }
+    
+    batch = 1;
+    nw = get_nthr();
+    if (nw > n) nw = n;
+    w = par_fork(&nw);
+    pipe_start(names, n, w, nw, 0);
+    for (i = w; i < n; i += nw)
+    {
+        res[i].nroi = -1;
+        if ( (numch = read_any(names[i])) < 0) continue;
+        if (nu > 0)
+        {
+            res[i].nroi = nu;
+            memcpy(res[i].lo, ulo, nu*sizeof(int));
+            memcpy(res[i].hi, uhi, nu*sizeof(int));
+        }
+        else
+        {
+            /*$ROI section of a .Spe, read with the spectrum*/
+            res[i].nroi = meta.nroi;
+            for (j = 0; j < meta.nroi; j++)
+            {
+                res[i].lo[j] = meta.roi[j][0];
+                res[i].hi[j] = meta.roi[j][1];
+            }
+        }
+        roi_areas(&res[i], numch);
+    }
+    pipe_stop();
+    par_wait(w, 0);
+    batch = bmo;
+    
+    if ( (fp = out_open(name, "w")) == NULL)
+    {
+        printf("Cannot open file: %s \n", name);
+        munmap(res, n*sizeof(struct roires));
+        return -1;
+    }
+    fprintf(fp, "spectrum,roi,first,last,gross,background,net,uncertainty\n");
+    for (i = 0, j = 0; i < n; i++)
+    {
+        csv_str(q, names[i]);
+        if (res[i].nroi <= 0) fprintf(fp, "%s,,,,,,,\n", q);
+        for (j = 0; j < res[i].nroi; j++)
+            fprintf(fp, "%s,%d,%d,%d,%.0f,%.1f,%.1f,%.1f\n", q, j,
+                    res[i].lo[j], res[i].hi[j], res[i].gross[j], res[i].bg[j],
+                    res[i].gross[j] - res[i].bg[j], res[i].err[j]);
+    }
+    if (out_close(fp) != 0)
+    {
+        printf("Error writing file: %s \n", name);
+        munmap(res, n*sizeof(struct roires));
+        return -1;
+    }
+    for (i = 0, j = 0; i < n; i++) j += res[i].nroi > 0 ? res[i].nroi : 0;
+    printf("Integrated %d ROIs of %d spectra ==> %s\n", j, n, name);
+    munmap(res, n*sizeof(struct roires));
+    return 0;
+} /*END roi_table()*/
+
+/*==========================================================================*/
+/* scan_num: read a number from *p (before e) into v and advance *p past    */
+/*           it, return -1 if there is none. Integers are converted here,   */
+/*           others by strtod()                                             */
+/****************************************************************************/
+int scan_num(char **p, char *e, float *v)
+{
+    char    *q = *p, *s, num[64];
+    long    n = 0;
+    int     neg = 0;
+    
+    while (q < e && isspace(*q)) q++;
+    if (q < e && (*q == '-' || *q == '+')) neg = (*q++ == '-');
+    for (s = q; q < e && *q >= '0' && *q <= '9' && q - s < 18; q++)
+        n = 10*n + (*q - '0');
+    
+    /*decimal point, exponent or very long: the general conversion*/
+    if (q < e && (*q == '.' || *q == 'e' || *q == 'E' || isdigit(*q)))
+    {
+        for (q = s - neg, n = 0; q < e && n < 63 && ! isspace(*q); q++)
+            num[n++] = *q;
+        num[n] = '\0';
+        *v = (float)strtod(num, &s);
+        if (s == num) return -1;
+        *p += (s - num) + (q - *p - n);
+        return 0;
+    }
+    if (q == s) return -1;
+    
+    *v = neg ? -(float)n : (float)n;
+    *p = q;
+    return 0;
+} /*END scan_num()*/
+
+/*==========================================================================*/
+/* set_ext: set file extension of string name[] to ext[]   	    	    */
+/****************************************************************************/
+void set_ext(char name[], char ext[])
+{    
+    /*if not equal to NULL, find '.' then copy ext with +1 for term char*/
+    if ( (strrchr(name,'.')) )
+        strncpy( (strrchr(name,'.')), ext, (int)(strlen(ext)+1) );
+    /*if equal to NULL just add ext to the end*/
+    else strcat( name, ext );
+} /*END set_ext()*/
+
+/*==========================================================================*/
+/* shm_write: publish spectrum in slot "name" of the shared memory segment  */
+/****************************************************************************/
+void shm_write(char name[], int numch)
+{
+    static struct shmdir *dir = NULL;
+    int     i, j, fd, new = 0;
+    unsigned int seq;
+    long    sz = sizeof(struct shmdir) + (long)NSHMSL*sizeof(struct shmslot);
+    struct  shmslot *sl = NULL;
+    
+    /*map the segment on first use; its creator writes the directory*/
+    if (dir == NULL)
+    {
+        if ( (fd = shm_open(SHMNAME, O_RDWR | O_CREAT | O_EXCL, 0644)) >= 0)
+            new = 1;
+        else fd = shm_open(SHMNAME, O_RDWR, 0644);
+        if (fd < 0 || (new && ftruncate(fd, sz) < 0)
+            || (dir = (struct shmdir *) mmap(NULL, sz, PROT_READ | PROT_WRITE,
+                MAP_SHARED, fd, 0)) == MAP_FAILED)
+        {
+            printf("Cannot map shared memory %s\n", SHMNAME);
+            if (fd >= 0) close(fd);
+            dir = NULL;
+            return ;
+        }
+        close(fd);
+        if (new)
+        {
+            dir->nslot = NSHMSL;
+            dir->chmax = CHMAX;
+            dir->slotsz = sizeof(struct shmslot);
+            __sync_synchronize();
+            strcpy(dir->magic, "SPECSHM");
+        }
+        for (i = 0; i < 1000 && strcmp(dir->magic, "SPECSHM"); i++) usleep(1000);
+        if (dir->nslot != NSHMSL || dir->slotsz != (int)sizeof(struct shmslot))
+        {
+            printf("Shared memory %s has a different layout\n", SHMNAME);
+            munmap(dir, sz);
+            dir = NULL;
+            return ;
+        }
+    }
+    
+    /*reuse the slot of this name, or claim a free one*/
+    for (i = 0; i < NSHMSL; i++)
+    {
+        sl = (struct shmslot *)(dir + 1) + i;
+        if (sl->state == 2 && ! strncmp(sl->name, name, CHLEN-1)) break;
+    }
+    for (j = 0; i == NSHMSL && j < NSHMSL; j++)
+    {
+        sl = (struct shmslot *)(dir + 1) + j;
+        if (__sync_bool_compare_and_swap(&sl->state, 0, 1)) break;
+    }
+    if (i == NSHMSL && j == NSHMSL)
+    {
+        printf("%s***No free shared memory slot for %s%s\n",clr[1],name,clr[0]);
+        return ;
+    }
+    
+    /*seqlock: readers retry while seq is odd or has changed; a writer
+        makes it odd only from even, so writers of a slot take turns*/
+    while ( (seq = sl->seq) & 1
+        || ! __sync_bool_compare_and_swap(&sl->seq, seq, seq + 1) )
+        usleep(100);
+    __sync_synchronize();
+    strncpy(sl->name, name, CHLEN-1);
+    memset(&sl->hdr, 0, sizeof(sl->hdr));
+    sl->hdr.q1 = 24;
+    /*name read from a RadWare spectrum, else the file name, as rad_write()*/
+    if ( (j = strlen(meta.name)) > 0) memcpy(sl->hdr.name, meta.name, j < 8 ? j : 8);
+    else
+    {
+        j = strrchr(name,'.') ? strrchr(name,'.') - &name[0] : strlen(name);
+        memcpy(sl->hdr.name, name, j < 8 ? j : 8);
+    }
+    if (j < 8) memset(&sl->hdr.name[j], ' ', 8-j);
+    sl->hdr.channels = numch;
+    sl->hdr.q2 = 1;
+    sl->hdr.q3 = 1;
+    sl->hdr.q4 = 1;
+    sl->hdr.q5 = 24;
+    sl->hdr.size = numch * sizeof(float);
+    memcpy(sl->data, spectrum, numch*sizeof(float));
+    __sync_synchronize();
+    __sync_fetch_and_add(&sl->seq, 1);
+    sl->state = 2;
+    __sync_fetch_and_add(&dir->gen, 1);
+    
+    printf(" ==> %s:%s %d chs.\n", SHMNAME, name, numch);
+} /*END shm_write()*/
+
+/*==========================================================================*/
+/* skip_hash: skip comment lines starting with hash (#) at start of file    */
+/****************************************************************************/
+void skip_hash(FILE *file)
+{
+    int     i = 0, hash = 0;
+    fpos_t  pos;
+    
+    for (i = 0; i < 1000; i++)
+    {
+    	/*store position corresponding to start of line*/
+    	fgetpos(file, &pos);
+        /*check for carriage return in the keyboard buffer
+            due to scanf function*/
+        if ( (hash = fgetc(file)) == '\n' ) fgetpos(file, &pos);
+    	else fsetpos(file, &pos);
+    	if ( (hash = fgetc(file)) != '#' )
+    	{
+    	    /*reset position to start of line*/
+    	    fsetpos(file, &pos);
+    	    break;
+    	}
+    	/*read rest of line*/
+    	while ( ( (hash = fgetc(file)) != '\n' ) && (hash != EOF) )
+            ;
+    }
+} /*END skip_hash()*/
+
+/*==========================================================================*/
+/* sniff_fmt: detect spectrum format from content, return the read mode     */
+/****************************************************************************/
+int sniff_fmt(char name[])
+{
+    int     fd, i, n, ch;
+    unsigned int ui[2];
+    short   sh[16];
+    char    buf[64];
+    struct  stat statbuf;
+    
+    if ( (fd = open(name, O_RDONLY)) < 0) return -1;
+    fstat(fd, &statbuf);
+    memset(buf, 0, sizeof(buf));
+    if ( (n = (int)pread(fd, buf, sizeof(buf), 0)) < 4)
+    {
+        close(fd);
+        return -1;
+    }
+    
+    /*RadWare: Fortran record length 24, then the channels*/
+    memcpy(ui, buf, 4);
+    memcpy(ui+1, buf+12, 4);
+    if (ui[0] != 24)
+    {
+        swapb4( (char *) &ui[0] );
+        swapb4( (char *) &ui[1] );
+    }
+    if (n >= 36 && ui[0] == 24 && ui[1] >= 1 && ui[1] <= CHMAX
+        && statbuf.st_size >= 36 + 4*(long)ui[1])
+    {
+        close(fd);
+        return 1;
+    }
+    
+    /*Maestro .Chn: header tag -1 and trailer tag -102 (102, -101) after
+        the data*/
+    memcpy(sh, buf, 32);
+    ch = (unsigned short)sh[15];
+    if (sh[0] == -1 && ch >= 1 && ch <= CHMAX
+        && pread(fd, sh, 2, 32 + 4*(long)ch) == 2
+        && (abs(sh[0]) == 102 || sh[0] == -101))
+    {
+        close(fd);
+        return 4;
+    }
+    close(fd);
+    
+    /*Maestro .Spe and GENIE .IEC text headers; sparse binary is read by
+        read_spec() from its extension*/
+    if (! strncmp(buf, "$SPEC_ID", 8)) return 9;
+    if (! strncmp(buf, "SPSPARSE", 8)) return 2;
+    if (! strncmp(buf, "A004", 4)) return 8;
+    
+    /*Ascii: only numbers and white space up to the first comment or
+        the end of the first buffer*/
+    for (i = 0; i < n && buf[i] != '#'; i++)
+        if (! isdigit(buf[i]) && ! isspace(buf[i]) && buf[i] != '.'
+            && buf[i] != '-' && buf[i] != '+' && buf[i] != 'e' && buf[i] != 'E')
+            break;
+    if (i == n || buf[i] == '#') return 2;
+    
+    /*Xtrack: headerless 4 byte channels, a multiple of 1024 channels
+        unless the name carries the multiple spectrum layout*/
+    if (statbuf.st_size >= 4096 && statbuf.st_size%4 == 0
+        && (statbuf.st_size%4096 == 0 || strstr(name, "__")) ) return 6;
+    return -1;
+} /*END sniff_fmt()*/
+
+/*==========================================================================*/
+/* snip_bg: SNIP background bg[] of y[] (n channels): iter clipping passes  */
+/*          of widths 1..iter, optionally smoothed and on an LLS scale      */
+/****************************************************************************/
+void snip_bg(float y[], float bg[], int n, int iter, int win, int lls)
+{
+    float   v[CHMAX], w[CHMAX], a;
+    double  sum;
+    int     i, p, h;
+    
+    /*log-log-sqrt transform compresses peaks relative to the continuum*/
+    for (i = 0; i < n; i++)
+    {
+        a = y[i] > 0.0 ? y[i] : 0.0;
+        v[i] = lls ? logf(logf(sqrtf(a + 1.0f) + 1.0f) + 1.0f) : a;
+    }
+    
+    /*moving average over win channels, from a running sum*/
+    if ( (h = win/2) > 0 && n > 2*h)
+    {
+        for (i = 0, sum = 0.0; i < 2*h; i++) sum += v[i];
+        memcpy(w, v, n*sizeof(float));
+        for (i = h; i < n - h; i++)
+        {
+            sum += v[i + h];
+            w[i] = (float)(sum/(2*h + 1));
+            sum -= v[i - h];
+        }
+        memcpy(v, w, n*sizeof(float));
+    }
+    
+    /*clipping: each pass only reads v[] and writes w[]*/
+    memcpy(w, v, n*sizeof(float));
+    for (p = 1; p <= iter && 2*p < n; p++)
+    {
+        for (i = p; i < n - p; i++)
+        {
+            a = 0.5f*(v[i - p] + v[i + p]);
+            w[i] = v[i] < a ? v[i] : a;
+        }
+        memcpy(v + p, w + p, (n - 2*p)*sizeof(float));
+    }
+    
+    for (i = 0; i < n; i++)
+    {
+        if (! lls) bg[i] = v[i];
+        else
+        {
+            a = expf(expf(v[i]) - 1.0f) - 1.0f;
+            bg[i] = a*a - 1.0f;
+        }
+        if (bg[i] < 0.0) bg[i] = 0.0;
+    }
+} /*END snip_bg()*/
+
+/*==========================================================================*/
+/* sock_client: send a batch conversion to a server and relay its output    */
+/****************************************************************************/
+int sock_client(char name[], int argc, char *argv[])
+{
+    extern int  md, inlin;
+    int     fd, i, n, rc = -1;
+    long    len, plen = 0, wall = 0, cpu = 0;
+    char    req[REQMAX], buf[8192], st[64] = "", *pay = NULL, *p;
+    struct  sockaddr_un sa;
+    struct  stat statbuf;
+    FILE    *fp;
+    
+    if (md <= 0 || optind >= argc)
+    {
+        printf("Server requests need -m mode and a file name\n");
+        return -1;
+    }
+    /*inline input: send the file contents rather than its name only*/
+    if (inlin)
+    {
+        if (stat(argv[optind], &statbuf) || (fp = fopen(argv[optind], "r")) == NULL)
+        {
+            printf("Cannot open file: %s \n", argv[optind]);
+            return -1;
+        }
+        plen = (long)statbuf.st_size;
+        if ( (pay = (char *) malloc(plen + 1)) == NULL
+            || (long)fread(pay, 1, plen, fp) != plen)
+        {
+            printf("Cannot read file: %s \n", argv[optind]);
+            fclose(fp);
+            free(pay);
+            return -1;
+        }
+        fclose(fp);
+    }
+    
+    /*request: cwd, payload length and the batch options then the remaining
+        arguments, each '\0' terminated, then an empty string*/
+    if (getcwd(req, REQMAX/2) == NULL) strcpy(req, "/");
+    len = strlen(req) + 1;
+    len += sprintf(req + len, "%ld", plen) + 1;
+    len += put_opts(req + len);
+    for (i = optind; i < argc; i++)
+    {
+        if (len + strlen(argv[i]) + 2 > REQMAX)
+        {
+            printf("Request too long\n");
+            free(pay);
+            return -1;
+        }
+        strcpy(req + len, argv[i]);
+        len += strlen(argv[i]) + 1;
+    }
+    req[len++] = '\0';
+    
+    memset(&sa, 0, sizeof(sa));
+    sa.sun_family = AF_UNIX;
+    strncpy(sa.sun_path, name, sizeof(sa.sun_path) - 1);
+    if ( (fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0
+        || connect(fd, (struct sockaddr *)&sa, sizeof(sa)) < 0)
+    {
+        printf("Cannot connect to server on socket %s\n", name);
+        if (fd >= 0) close(fd);
+        free(pay);
+        return -1;
+    }
+    signal(SIGPIPE, SIG_IGN);
+    for (i = 0; i < len; i += n) if ( (n = write(fd, req + i, len - i)) <= 0) break;
+    for (i = 0; i < plen; i += n) if ( (n = write(fd, pay + i, plen - i)) <= 0) break;
+    free(pay);
+    
+    /*relay output up to the '\001' that starts the status line*/
+    len = -1;
+    while ( (n = read(fd, buf, sizeof(buf))) > 0)
+    {
+        if (len < 0 && (p = memchr(buf, '\001', n)) != NULL)
+        {
+            fwrite(buf, 1, p - buf, stdout);
+            len = 0;
+            n -= (p - buf) + 1;
+            memmove(buf, p + 1, n);
+        }
+        if (len < 0) fwrite(buf, 1, n, stdout);
+        else for (i = 0; i < n && len < (long)sizeof(st) - 1; i++) st[len++] = buf[i];
+    }
+    close(fd);
+    fflush(stdout);
+    if (len < 0 || sscanf(st, "STATUS %d %ld %ld", &rc, &wall, &cpu) != 3)
+    {
+        fprintf(stderr, "No status from server\n");
+        return -1;
+    }
+    fprintf(stderr, "status %d, %ld us wall, %ld us cpu\n", rc, wall, cpu);
+    return rc;
+} /*END sock_client()*/
+
+/*==========================================================================*/
+/* sock_serve: serve batch conversions on a UNIX socket from warm workers   */
+/****************************************************************************/
+int sock_serve(char name[])
+{
+    int     i, fd, nw;
+    pid_t   pid[MXTHR], p;
+    struct  sockaddr_un sa;
+    
+    if (strlen(name) >= sizeof(sa.sun_path))
+    {
+        printf("Socket name %s is too long\n", name);
+        return -1;
+    }
+    memset(&sa, 0, sizeof(sa));
+    sa.sun_family = AF_UNIX;
+    strcpy(sa.sun_path, name);
+    unlink(name);
+    if ( (fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0
+        || bind(fd, (struct sockaddr *)&sa, sizeof(sa)) < 0
+        || chmod(name, 0600) < 0 || listen(fd, 64) < 0)
+    {
+        printf("Cannot listen on socket %s\n", name);
+        return -1;
+    }
+    signal(SIGPIPE, SIG_IGN);
+    nw = get_nthr();
+    printf("Serving conversions on %s with %d workers\n", name, nw);
+    fflush(stdout);
+    
+    /*workers are forked once and accept requests in turn; one that dies
+        (e.g. exits on an error) is replaced*/
+    for (i = 0; i < nw; i++) pid[i] = -1;
+    while (1)
+    {
+        for (i = 0; i < nw; i++)
+        {
+            if (pid[i] > 0) continue;
+            if ( (pid[i] = fork()) == 0)
+            {
+                sock_work(fd);
+                _exit(0);
+            }
+        }
+        if ( (p = wait(NULL)) < 0) break;
+        for (i = 0; i < nw; i++) if (pid[i] == p) pid[i] = -1;
+    }
+    close(fd);
+    unlink(name);
+    return -1;
+} /*END sock_serve()*/
+
+/*==========================================================================*/
+/* sock_work: server worker, runs requests accepted on socket lfd           */
+/****************************************************************************/
+void sock_work(int lfd)
+{
+    extern float gain[3];
+    extern int  md, ofmt, batch, ovwr, inlin;
+    extern char sockname[CHLEN], outopt[CHLEN], layopt[CHLEN];
+    int     argc, cfd, i, k, n, out, rc, srv;
+    long    len, hl, plen;
+    char    req[REQMAX], *argv[REQMAX/2], *cwd, *p;
+    struct  timeval t0, t1;
+    struct  rusage r0, r1;
+    
+    /*prompts must see end of input rather than wait*/
+    if ( (i = open("/dev/null", O_RDONLY)) >= 0)
+    {
+        dup2(i, 0);
+        close(i);
+    }
+    out = dup(1);
+    while (1)
+    {
+        if ( (cfd = accept(lfd, NULL, NULL)) < 0) continue;
+        gettimeofday(&t0, NULL);
+        getrusage(RUSAGE_SELF, &r0);
+        
+        /*read up to the empty string that ends the arguments*/
+        for (len = 0, hl = 0; hl == 0 && len < REQMAX; len += n)
+        {
+            if ( (n = read(cfd, req + len, REQMAX - len)) <= 0) break;
+            for (i = 0, k = 0; i < len + n; i++)
+            {
+                if (req[i] != '\0') continue;
+                if (i == k)
+                {
+                    hl = i + 1;
+                    break;
+                }
+                k = i + 1;
+            }
+        }
+        if (hl == 0)
+        {
+            close(cfd);
+            continue;
+        }
+        
+        /*reset state left by the previous request*/
+        md = 0;
+        ofmt = 1;
+        batch = ovwr = inlin = 0;
+        gain[0] = gain[1] = gain[2] = 0.0;
+        sockname[0] = outopt[0] = layopt[0] = stname[0] = roiopt[0] = '\0';
+        wlo = nstw = 0;
+        whi = -1;
+        bgit = bgwin = bglls = bgout = arerr = rbfac = pyrout = 0;
+        metaout = 1;
+        rbg[0] = rbg[1] = rbg[2] = 0.0;
+        aropt[0] = failopt[0] = walkflt[0] = '\0';
+        nfail = 0;
+        /*spectrum files of an expression may have changed*/
+        for (i = 0; i < arcache.n; i++) free(arcache.y[i]);
+        arcache.n = 0;
+        memfile.buf = NULL;
+        optind = 0;
+        
+        cwd = req;
+        p = cwd + strlen(cwd) + 1;
+        plen = atol(p);
+        argv[0] = "spec_conv";
+        for (argc = 1, p += strlen(p) + 1; *p != '\0' && argc < REQMAX/2 - 1;
+                p += strlen(p) + 1) argv[argc++] = p;
+        argv[argc] = NULL;
+        
+        /*inline payload follows the arguments*/
+        if (plen > 0 && (memfile.buf = (char *) malloc(plen)) != NULL)
+        {
+            memfile.len = len - hl < plen ? len - hl : plen;
+            memcpy(memfile.buf, req + hl, memfile.len);
+            while (memfile.len < plen && (n = read(cfd, memfile.buf + memfile.len,
+                    plen - memfile.len)) > 0) memfile.len += n;
+        }
+        
+        fflush(stdout);
+        dup2(cfd, 1);
+        srv = 0;
+        if (chdir(cwd) != 0)
+        {
+            printf("Cannot change to directory %s\n", cwd);
+            rc = -1;
+        }
+        else if ( (rc = get_opts(argc, argv, &srv)) == 0 && (srv || ! batch))
+        {
+            printf("Server requests need -m mode and no -S/-C\n");
+            rc = -1;
+        }
+        if (rc == 0)
+        {
+            if (memfile.buf && optind < argc)
+                strncpy(memfile.name, argv[optind], CHLEN-1);
+            rc = run_conv(argc - optind + 1, argv + optind - 1);
+        }
+        pipe_stop();
+        walk_stop();
+        /*a list the request left unfinished must not carry over*/
+        read_lst(NULL, 0);
+        jnl_close(rc);
+        rc = fail_done(rc);
+        stat_done();
+        fflush(stdout);
+        dup2(out, 1);
+        free(memfile.buf);
+        memfile.buf = NULL;
+        
+        gettimeofday(&t1, NULL);
+        getrusage(RUSAGE_SELF, &r1);
+        sprintf(req, "\001STATUS %d %ld %ld\n", rc,
+            (t1.tv_sec - t0.tv_sec)*1000000L + (t1.tv_usec - t0.tv_usec),
+            (r1.ru_utime.tv_sec + r1.ru_stime.tv_sec
+                - r0.ru_utime.tv_sec - r0.ru_stime.tv_sec)*1000000L
+            + (r1.ru_utime.tv_usec + r1.ru_stime.tv_usec
+                - r0.ru_utime.tv_usec - r0.ru_stime.tv_usec));
+        if (write(cfd, req, strlen(req)) < 0) ;
+        close(cfd);
+    }
+} /*END sock_work()*/
+
+/*==========================================================================*/
+/* sp_magic: 1 if file name starts as a sparse binary spectrum, else 0      */
+/****************************************************************************/
+int sp_magic(char name[])
+{
+    int     i;
+    char    magic[8];
+    FILE    *fsp;
+    
+    if ( (fsp = spec_open(name, "r")) == NULL) return 0;
+    i = (fread(magic, 8, 1, fsp) == 1 && ! strncmp(magic, "SPSPARSE", 8));
+    spec_close(fsp);
+    return i;
+} /*END sp_magic()*/
+
+/*==========================================================================*/
+/* sp_pack: list the nonzero channels of spectrum[] in sparse, return count */
+/****************************************************************************/
+int sp_pack(int numch)
+{
+    int     i, n = 0;
+    
+    for (i = 0; i < numch; i++)
+    {
+        if (spectrum[i] == 0.0) continue;
+        sparse.ch[n] = i;
+        sparse.cnt[n++] = spectrum[i];
+    }
+    sparse.numch = numch;
+    return (sparse.n = n);
+} /*END sp_pack()*/
+
+/*==========================================================================*/
+/* sp_read: read a sparse binary spectrum: "SPSPARSE", channels, number of  */
+/*  nonzero channels n, then the n channels (int) and n counts (float)      */
+/****************************************************************************/
+int sp_read(char name[])
+{
+    int     i, hd[2];
+    char    magic[8];
+    FILE    *fsp;
+    
+    if ( (fsp = spec_open(name, "r")) == NULL)
+    {
+    	printf("Cannot open file: %s\n", name);
+	return -1;
+    }
+    if (fread(magic, 8, 1, fsp) != 1 || strncmp(magic, "SPSPARSE", 8)
+        || fread(hd, sizeof(int), 2, fsp) != 2 || hd[0] < 1 || hd[0] > CHMAX
+        || hd[1] < 0 || hd[1] > hd[0]
+        || fread(sparse.ch, sizeof(int), hd[1], fsp) != hd[1]
+        || fread(sparse.cnt, sizeof(float), hd[1], fsp) != hd[1])
+    {
+        printf("%s***Not a sparse spectrum: %s%s\n",clr[1],name,clr[0]);
+        spec_close(fsp);
+        return -1;
+    }
+    spec_close(fsp);
+    sparse.numch = hd[0];
+    sparse.n = hd[1];
+    for (i = 0; i < sparse.n; i++)
+        if (sparse.ch[i] >= 0 && sparse.ch[i] < CHMAX)
+            spectrum[sparse.ch[i]] = sparse.cnt[i];
+    printf("Sparse spectrum: %d of %d channels nonzero\n", sparse.n, sparse.numch);
+    return sparse.numch;
+} /*END sp_read()*/
+
+/*==========================================================================*/
+/* sp_write: write nonzero channels only, binary (bin = 1) or as ascii      */
+/*  (channel counts) pairs which ascii_read() reads as 2 columns            */
+/****************************************************************************/
+void sp_write(char name[], int numch, int bin)
+{
+    int     i;
+    FILE    *fsp;
+    
+    if ( (fsp = spec_open(name, "w" )) == NULL)
+    {
+        printf("Cannot open file: %s \n", name);
+        return ; 
+    }
+    sp_pack(numch);
+    if (bin)
+    {
+        /*channels and counts as separate blocks*/
+        fwrite("SPSPARSE", 8, 1, fsp);
+        fwrite(&sparse.numch, sizeof(int), 1, fsp);
+        fwrite(&sparse.n, sizeof(int), 1, fsp);
+        fwrite(sparse.ch, sizeof(int), sparse.n, fsp);
+        fwrite(sparse.cnt, sizeof(float), sparse.n, fsp);
+    }
+    else
+    {
+        /*the last channel is always written to keep the length*/
+        fprintf(fsp, "# sparse spectrum: %d channels, %d nonzero\n",
+                numch, sparse.n);
+        for (i = 0; i < sparse.n; i++)
+            fprintf(fsp, "%d %.5f\n", sparse.ch[i], sparse.cnt[i]);
+        if (numch > 0 && (sparse.n == 0 || sparse.ch[sparse.n-1] != numch-1))
+            fprintf(fsp, "%d %.5f\n", numch-1, 0.0);
+    }
+    printf(" ==> %s %d chs. (%d nonzero)\n", name, numch, sparse.n);
+    spec_close(fsp);
+} /*END sp_write()*/
+
+/*==========================================================================*/
+/* spe_index: find the $SECTION markers (at line starts) of a Maestro .Spe  */
+/*            in buf..e, return how many were found                        */
+/****************************************************************************/
+int spe_index(char *buf, char *e, char *sec[], int max)
+{
+    char    *p;
+    int     n = 0;
+    
+    /*memchr() scans many bytes per step*/
+    for (p = buf; n < max && p < e && (p = memchr(p, '$', e - p)) != NULL; p++)
+        if (p == buf || p[-1] == '\n') sec[n++] = p;
+    return n;
+} /*END spe_index()*/
+
+/*==========================================================================*/
+/* spe_read: read a Maestro .Spe spectrum and its header/trailer sections   */
+/****************************************************************************/
+int spe_read(char name[])
+{
+    extern float spectrum[CHMAX];
+    float   v, w;
+    int     i, j, k, nsec, lo = 0, hi = -1;
+    long    len;
+    char    *buf, *e, *p, *q, *sec[NSPESEC], ln[CHLEN];
+    
+    if ( (buf = load_file(name, &len)) == NULL) return -1;
+    e = buf + len;
+    nsec = spe_index(buf, e, sec, NSPESEC);
+    strcpy(meta.fmt, "Maestro_Spe");
+    
+    for (k = 0; k < nsec; k++)
+    {
+        /*section from the line after its tag to the next tag*/
+        if ( (p = memchr(sec[k], '\n', e - sec[k])) == NULL) continue;
+        p++;
+        q = k < nsec - 1 ? sec[k+1] : e;
+        for (i = 0; i < CHLEN - 1 && p + i < q && p[i] != '\n'; i++) ln[i] = p[i];
+        ln[i] = '\0';
+        
+        if (! strncmp(sec[k], "$DATA:", 6))
+        {
+            if (scan_num(&p, q, &v) < 0 || scan_num(&p, q, &w) < 0) continue;
+            lo = (int)v;
+            hi = (int)w;
+            if (lo < 0 || lo >= CHMAX) lo = 0;
+            for (j = lo; j <= hi && j < CHMAX && scan_num(&p, q, &spectrum[j]) == 0; j++) ;
+            hi = j - 1;
+            meta.off = lo;
+            meta.channels = hi - lo + 1;
+        }
+        else if (! strncmp(sec[k], "$MEAS_TIM:", 10))
+            sscanf(ln, "%f %f", &meta.live, &meta.real);
+        else if (! strncmp(sec[k], "$DATE_MEA:", 10))
+            sscanf(ln, "%11s %9s", meta.date, meta.time);
+        else if (! strncmp(sec[k], "$MCA_CAL:", 9))
+        {
+            /*number of coefficients, then the coefficients*/
+            if (scan_num(&p, q, &v) < 0) continue;
+            for (i = 0; i < (int)v && i < 3 && scan_num(&p, q, &meta.cal[i]) == 0; i++) ;
+        }
+        else if (! strncmp(sec[k], "$ENER_FIT:", 10))
+            sscanf(ln, "%f %f", &meta.fit[0], &meta.fit[1]);
+        else if (! strncmp(sec[k], "$ROI:", 5))
+        {
+            if (scan_num(&p, q, &v) < 0) continue;
+            for (i = 0; i < (int)v && i < MXROI && scan_num(&p, q, &w) == 0; i++)
+            {
+                meta.roi[i][0] = (int)w;
+                if (scan_num(&p, q, &w) < 0) break;
+                meta.roi[i][1] = (int)w;
+            }
+            meta.nroi = i;
+        }
+    }
+    free(buf);
+    
+    if (hi < lo)
+    {
+        printf("%s***No $DATA in file %s%s\n",clr[1],name,clr[0]);
+        return -1;
+    }
+    printf("%sSpectrum date: %s %s%s\n",clr[2],meta.date,meta.time,clr[0]);
+    printf("    %sLive time: %.2f s, Real time %.2f s%s\n",
+        clr[2],meta.live,meta.real,clr[0]);
+    printf("    %sFirst chan: %d, last chan %d%s\n",clr[2],lo,hi,clr[0]);
+    printf("Maestro calibration coefficients: %g %g %g\n\n",
+        meta.cal[0],meta.cal[1],meta.cal[2]);
+    return hi + 1;
+} /*END spe_read()*/
+
+/*==========================================================================*/
+/* spe_write: write a Maestro .Spe spectrum with the sections spe_read()    */
+/*            knows, built in memory and written at once                    */
+/****************************************************************************/
+void spe_write(char name[], int numch)
+{
+    int     i, y, mo, d, hms[3], off;
+    long    len = 0;
+    char    *buf, *id;
+    FILE    *fsp;
+    
+    /*$DATA from the window start or first channel read, as chn_write()*/
+    off = whi >= 0 && rbfac < 2 && rbg[1] == 0.0 ? wlo : meta.off;
+    if (off < 0 || off >= numch) off = 0;
+    for (i = 0; i < off && spectrum[i] == 0.0; i++) ;
+    if (i < off) off = 0;
+    
+    /*at most 11 bytes a channel, the rest is well under 8 kB*/
+    if ( (buf = (char *) malloc(numch*11L + 8192)) == NULL)
+    {
+        printf("Cannot allocate memory for %s \n", name);
+        return ;
+    }
+    id = strlen(meta.name) ? meta.name : (strrchr(meta.src,'/') ?
+            strrchr(meta.src,'/') + 1 : meta.src);
+    len += sprintf(buf+len, "$SPEC_ID:\n%s\n$SPEC_REM:\n%s\n", id,
+            strlen(meta.fmt) ? meta.fmt : "spec_conv");
+    if (meta_date(&y, &mo, &d, hms) == 0)
+        len += sprintf(buf+len, "$DATE_MEA:\n%02d/%02d/%04d %02d:%02d:%02d\n",
+                mo, d, y, hms[0], hms[1], hms[2]);
+    if (meta.live >= 0.0 || meta.real >= 0.0)
+        len += sprintf(buf+len, "$MEAS_TIM:\n%.0f %.0f\n",
+                meta.live > 0.0 ? meta.live : 0.0,
+                meta.real > 0.0 ? meta.real : 0.0);
+    len += sprintf(buf+len, "$DATA:\n%d %d\n", off, numch - 1);
+    for (i = off; i < numch; i++)
+        len += sprintf(buf+len, "%8d\n",
+                spectrum[i] > 0.0 ? (int)(spectrum[i] + 0.5) : 0);
+    len += sprintf(buf+len, "$ROI:\n%d\n", meta.nroi);
+    for (i = 0; i < meta.nroi; i++)
+        len += sprintf(buf+len, "%d %d\n", meta.roi[i][0], meta.roi[i][1]);
+    len += sprintf(buf+len, "$PRESETS:\nNone\n0\n0\n");
+    if (meta.fit[0] != 0.0 || meta.fit[1] != 0.0)
+        len += sprintf(buf+len, "$ENER_FIT:\n%f %f\n", meta.fit[0], meta.fit[1]);
+    len += sprintf(buf+len, "$MCA_CAL:\n3\n%E %E %E keV\n",
+            meta.cal[0], meta.cal[1], meta.cal[2]);
+    
+    if ( (fsp = spec_open(name, "w" )) == NULL)
+    {
+        printf("Cannot open file: %s \n", name);
+        free(buf);
+        return ; 
+    }
+    if (fwrite(buf, len, 1, fsp) != 1)
+        printf("Error writing to file: %s \n", name);
+    else printf(" ==> %s %d chs.\n", name, numch);
+    spec_close(fsp);
+    free(buf);
+} /*END spe_write()*/
+
+/*==========================================================================*/
+/* spec_close: close a spectrum file, queueing pipeline output for writing  */
+/****************************************************************************/
+int spec_close(FILE *fp)
+{
+    int     i, rc;
+    long    len;
+    char    name[CHLEN+8] = "";
+    
+    for (i = 0; i < NOBUF; i++) if (pipeline.ofp[i] == fp) break;
+    if (fp == NULL) return EOF;
+    if (i == NOBUF)
+    {
+        for (i = 0; i < NTMPO && tmpout.fp[i] != fp; i++) ;
+        if (i < NTMPO) strcpy(name, tmpout.name[i]);
+        if ( (rc = out_close(fp)) != 0 && strlen(name))
+        {
+            nfail++;
+            out_fail(name, journal.cur);
+        }
+        return rc;
+    }
+    
+    fflush(fp);
+    len = ftell(fp);
+    fclose(fp);
+    pthread_mutex_lock(&pipeline.mx);
+    pipeline.ofp[i] = NULL;
+    if (len >= OBUFSZ)
+    {
+        printf("%s***Output %s is larger than %d bytes, not written%s\n",
+                clr[1],pipeline.oname[i],OBUFSZ,clr[0]);
+        nfail++;
+        out_fail(pipeline.oname[i], journal.cur);
+        pipeline.olen[i] = -1;
+    }
+    else
+    {
+        pipeline.olen[i] = len;
+        pipeline.oq[pipeline.ocnt++] = i;
+    }
+    pthread_cond_broadcast(&pipeline.cv);
+    pthread_mutex_unlock(&pipeline.mx);
+    return len >= OBUFSZ ? EOF : 0;
+} /*END spec_close()*/
+
+/*==========================================================================*/
+/* spec_hash: 64-bit hash of n words, four independent (vectorisable) lanes */
+/****************************************************************************/
+unsigned long long spec_hash(unsigned int *p, long n)
+{
+    int     k;
+    long    i;
+    unsigned long long h[4] = {0xcbf29ce484222325ULL, 0x84222325cbf29ce4ULL,
+                               0x9e3779b97f4a7c15ULL, 0x7f4a7c159e3779b9ULL};
+    unsigned long long r = (unsigned long long)n;
+    
+    for (i = 0; i + 4 <= n; i += 4)
+        for (k = 0; k < 4; k++) h[k] = (h[k] ^ p[i+k])*0x100000001b3ULL;
+    for (; i < n; i++) h[0] = (h[0] ^ p[i])*0x100000001b3ULL;
+    
+    for (k = 0; k < 4; k++)
+    {
+        r = (r ^ h[k])*0x9e3779b97f4a7c15ULL;
+        r ^= r >> 29;
+    }
+    return r ? r : 1;
+} /*END spec_hash()*/
+
+/*==========================================================================*/
+/* spec_open: open a spectrum file, from/to pipeline buffers when running   */
+/****************************************************************************/
+FILE *spec_open(char name[], char mode[])
+{
+    int     i, j, k;
+    FILE    *fp = NULL;
+    struct  pfslot *sl;
+    
+    if (mode[0] == 'r' && memfile.buf && ! strcmp(memfile.name, name))
+        return fmemopen(memfile.buf, memfile.len, mode);
+    if (! pipeline.run) return mode[0] == 'r' ? fopen(name, mode)
+                                               : out_open(name, mode);
+    pthread_mutex_lock(&pipeline.mx);
+    
+    /*output: wait for a free buffer and write into it*/
+    if (mode[0] == 'w' || mode[0] == 'a')
+    {
+        while (1)
+        {
+            for (i = 0; i < NOBUF; i++)
+                if (pipeline.olen[i] < 0 && pipeline.ofp[i] == NULL) break;
+            if (i < NOBUF) break;
+            pthread_cond_wait(&pipeline.cv, &pipeline.mx);
+        }
+        if (pipeline.obuf[i] == NULL)
+            pipeline.obuf[i] = (char *) malloc(OBUFSZ);
+        if (pipeline.obuf[i]
+            && (fp = fmemopen(pipeline.obuf[i], OBUFSZ, "w")) != NULL)
+        {
+            strncpy(pipeline.oname[i], name, CHLEN-1);
+            strncpy(pipeline.oent[i], journal.cur, CHLEN-1);
+            pipeline.omode[i] = mode[0];
+            pipeline.ofp[i] = fp;
+        }
+        pthread_mutex_unlock(&pipeline.mx);
+        return fp ? fp : out_open(name, mode);
+    }
+    
+    /*input: the current slot may be re-opened (multiple spectrum files),
+        otherwise move on to the prefetched entry of that name, dropping the
+        entries before it that were never opened (unrecognised, or skipped
+        as empty); these were read in full before it was started*/
+    if (pipeline.cur < 0 || strcmp(pipeline.slot[pipeline.cur].name, name))
+    {
+        if (pipeline.cur >= 0)
+        {
+            pipeline.head = (pipeline.head + 1)%NPREF;
+            pipeline.cnt--;
+            pipeline.cur = -1;
+            pthread_cond_broadcast(&pipeline.cv);
+        }
+        while (1)
+        {
+            for (i = 0; i < pipeline.cnt && strcmp(pipeline.slot[(pipeline.head
+                + i)%NPREF].name, name); i++) ;
+            /*an entry the prefetcher has still to take: it goes on from
+                there, and is waited for*/
+            for (j = 0, k = pipeline.next; j < NPREF && k < pipeline.n
+                && strcmp(pipeline.names[k], name); j++, k += pipeline.nw) ;
+            if (i < pipeline.cnt || j == NPREF || k >= pipeline.n) break;
+            pipeline.next = k;
+            pipeline.head = (pipeline.head + pipeline.cnt)%NPREF;
+            pipeline.cnt = 0;
+            pthread_cond_broadcast(&pipeline.cv);
+            pthread_cond_wait(&pipeline.cv, &pipeline.mx);
+        }
+        if (i < pipeline.cnt)
+        {
+            pipeline.head = (pipeline.head + i)%NPREF;
+            pipeline.cnt -= i;
+            pipeline.cur = pipeline.head;
+            if (i > 0) pthread_cond_broadcast(&pipeline.cv);
+        }
+    }
+    if (pipeline.cur >= 0)
+    {
+        sl = &pipeline.slot[pipeline.cur];
+        while (sl->state == 0) pthread_cond_wait(&pipeline.cv, &pipeline.mx);
+        if (sl->state == 1) fp = fmemopen(sl->buf, sl->len, mode);
+    }
+    pthread_mutex_unlock(&pipeline.mx);
+    return fp ? fp : fopen(name, mode);
+} /*END spec_open()*/
+
+/*==========================================================================*/
+/* spec_sums: hash each of mxsp spectra of len bytes in a mapped file       */
+/****************************************************************************/
+int spec_sums(char name[], unsigned long long sum[], int mxsp, long len)
+{
+    int     i, fd;
+    unsigned char *map;
+    struct  stat statbuf;
+    
+    if ( (fd = open(name, O_RDONLY)) < 0) return -1;
+    if (fstat(fd, &statbuf) < 0 || statbuf.st_size < (long)mxsp*len
+        || (map = (unsigned char *) mmap(NULL, statbuf.st_size, PROT_READ,
+            MAP_PRIVATE, fd, 0)) == MAP_FAILED)
+    {
+        close(fd);
+        return -1;
+    }
+    for (i = 0; i < mxsp; i++)
+        sum[i] = spec_hash((unsigned int *)(map + (long)i*len), len/4);
+    munmap(map, statbuf.st_size);
+    close(fd);
+    return 0;
+} /*END spec_sums()*/
+
+/*==========================================================================*/
+/* stat_done: close the -s table, renaming stname.tmp to stname             */
+/****************************************************************************/
+void stat_done(void)
+{
+    char    tmp[CHLEN+4];
+    
+    if (statfd < 0) return ;
+    sprintf(tmp, "%s.tmp", stname);
+    if (close(statfd) < 0) unlink(tmp);
+    else if (rename(tmp, stname) < 0)
+        printf("Cannot rename %s to %s\n", tmp, stname);
+    statfd = -1;
+} /*END stat_done()*/
+
+/*==========================================================================*/
+/* stat_spec: append statistics of spectrum "name" to the -s table          */
+/****************************************************************************/
+void stat_spec(char name[], int numch)
+{
+    int     i, k, f, l, imx = 0;
+    float   mx = 0.0;
+    double  tot = 0.0, mom = 0.0, w;
+    char    row[2*CHLEN + 200 + 16*NSTW];
+    
+    /*sums, then the scans*/
+    for (i = 0; i < numch; i++)
+    {
+        tot += spectrum[i];
+        mom += i*spectrum[i];
+    }
+    for (i = 0; i < numch; i++)
+        if (spectrum[i] > mx)
+        {
+            mx = spectrum[i];
+            imx = i;
+        }
+    for (f = 0; f < numch && spectrum[f] == 0.0; f++) ;
+    for (l = numch - 1; l >= 0 && spectrum[l] == 0.0; l--) ;
+    if (f == numch) f = -1;
+    
+    k = csv_str(row, name);
+    k += sprintf(row + k, ",%d,%.0f,%.0f,%d,%d,%d,%.3f", numch, tot, mx,
+            imx, f, l, tot != 0.0 ? mom/tot : 0.0);
+    for (i = 0; i < nstw; i++)
+    {
+        for (w = 0.0, f = stw[i][0] > 0 ? stw[i][0] : 0;
+                f <= stw[i][1] && f < numch; f++) w += spectrum[f];
+        k += sprintf(row + k, ",%.0f", w);
+    }
+    row[k++] = '\n';
+    /*one write per row: rows of concurrent workers are not interleaved*/
+    if (write(statfd, row, k) < 0) ;
+} /*END stat_spec()*/
+
+/*==========================================================================*/
+/* store_colours: store colours in clr[][] array                            */
+/****************************************************************************/
+void store_colours()
+{
+    /*none*/
+    strcpy(clr[0], "\033[0;0m");
+    /*white on red background*/
+    strcpy(clr[1], "\033[0;41m");
+    /*green no background*/
+    strcpy(clr[2], "\033[0;32m");
+    /*white on blue background*/
+    strcpy(clr[3], "\033[0;44m");
+    /*bold*/
+    strcpy(clr[4], "\033[1m");
+    /*underline*/
+    strcpy(clr[5], "\033[0;4m");
+} /*END store_colours()*/  
+
+/*==========================================================================*/
+/* store_formats: store extensions and formats of input/output options      */
+/****************************************************************************/
+void store_formats()
+{
+    /*fill input extension arrays and input format arrays.
+        Note strlen+1 is used to terminate strings*/
+    strncpy(exti[0], ".spe", 5);         strncpy(fmti[0], "RadWare", 8);
+    strncpy(exti[1], ".txt", 5);         strncpy(fmti[1], "Ascii", 6);
+    strncpy(exti[2], ".txt", 5);         strncpy(fmti[2], "Ascii", 6);
+    strncpy(exti[3], ".Chn", 5);         strncpy(fmti[3], "Maestro_Chn", 12);
+    strncpy(exti[4], ".Chn", 5);         strncpy(fmti[4], "Maestro_Chn", 12);
+    strncpy(exti[5], ".spec", 6);        strncpy(fmti[5], "Xtrack", 7);
+    strncpy(exti[6], ".spec", 6);        strncpy(fmti[6], "Xtrack", 7);
+    strncpy(exti[7], ".IEC", 5);         strncpy(fmti[7], "GENIE", 6);
+    strncpy(exti[8], ".Spe", 5);         strncpy(fmti[8], "Maestro_Spe", 12);
+    strncpy(exti[9], ".Spe", 5);         strncpy(fmti[9], "Maestro_Spe", 12);
+    strncpy(exti[10], ".lmd", 5);        strncpy(fmti[10], "ListMode", 9);
+    strncpy(exti[11], ".Chn", 5);        strncpy(fmti[11], "Spectra", 8);
+    strncpy(exti[12], ".*", 3);          strncpy(fmti[12], "Auto-detect", 12);
+    strncpy(exti[13], ".spe", 5);        strncpy(fmti[13], "Spectra", 8);
+    strncpy(exti[14], ".spec", 6);       strncpy(fmti[14], "Xtrack_multi", 13);
+    strncpy(exti[15], ".Spe", 5);        strncpy(fmti[15], "Spectra", 8);
+    strncpy(exti[NUMOPT-1], ".spe", 5);  strncpy(fmti[NUMOPT-1], "RadWare", 8);
+    
+    /*fill output extension arrays*/
+    strncpy(ext[0], ".txt", 5);                 strncpy(fmt[0], "Ascii", 6);
+    strncpy(ext[1], ".spe", 5);                 strncpy(fmt[1], "RadWare", 8);
+    strncpy(ext[2], ".spec", 6);                strncpy(fmt[2], "Xtrack", 7);
+    strncpy(ext[3], ".txt", 5);                 strncpy(fmt[3], "Ascii", 6);
+    strncpy(ext[4], ".spe", 5);                 strncpy(fmt[4], "RadWare", 8);
+    strncpy(ext[5], ".txt", 5);                 strncpy(fmt[5], "Ascii", 6);
+    strncpy(ext[6], ".spe", 5);                 strncpy(fmt[6], "RadWare", 8);
+    strncpy(ext[7], ".spe", 5);                 strncpy(fmt[7], "RadWare", 8);
+    strncpy(ext[8], ".spe", 5);                 strncpy(fmt[8], "RadWare", 8);
+    strncpy(ext[9], ".txt", 5);                 strncpy(fmt[9], "Ascii", 6);
+    strncpy(ext[10], ".spe", 5);                strncpy(fmt[10], "RadWare", 8);
+    strncpy(ext[11], ".csv", 5);                strncpy(fmt[11], "Header_table", 13);
+    strncpy(ext[12], ".spe", 5);                strncpy(fmt[12], "RadWare", 8);
+    strncpy(ext[13], ".spec", 6);               strncpy(fmt[13], "Xtrack_multi", 13);
+    strncpy(ext[14], ".npy", 5);                strncpy(fmt[14], "NumPy_2D", 9);
+    strncpy(ext[15], ".csv", 5);                strncpy(fmt[15], "ROI_table", 10);
+    strncpy(ext[NUMOPT-1], "_mtchd.spe", 11);   strncpy(fmt[NUMOPT-1], "RadWare", 8);
+    
+    /*fill selectable output format arrays (index is ofmt)*/
+    strncpy(oext[0], ".txt", 5);                strncpy(ofmtn[0], "Ascii", 6);
+    strncpy(oext[1], ".spe", 5);                strncpy(ofmtn[1], "RadWare", 8);
+    strncpy(oext[2], ".spec", 6);               strncpy(ofmtn[2], "Xtrack", 7);
+    strncpy(oext[3], ".npy", 5);                strncpy(ofmtn[3], "NumPy", 6);
+    strncpy(oext[4], ".f32", 5);                strncpy(ofmtn[4], "Raw_f32+json", 13);
+    strncpy(oext[5], ".shm", 5);                strncpy(ofmtn[5], "Shared_memory", 14);
+    strncpy(oext[6], ".ssp", 5);                strncpy(ofmtn[6], "Sparse_binary", 14);
+    strncpy(oext[7], ".spt", 5);                strncpy(ofmtn[7], "Sparse_ascii", 13);
+    strncpy(oext[8], ".Chn", 5);                strncpy(ofmtn[8], "Maestro_Chn", 12);
+    strncpy(oext[9], ".Spe", 5);                strncpy(ofmtn[9], "Maestro_Spe", 12);
+} /*END store_formats()*/  
+
+/*==========================================================================*/
+/* sum_file: read (wr = 0) or write checksum sidecar "name.sum", returns    */
+/*  the number of checksums read, 0 if the layout or the options of the     */
+/*  run that wrote them do not match                                        */
+/****************************************************************************/
+int sum_file(char name[], unsigned long long sum[], int mxsp, long len, int wr)
+{
+    int     i, n = 0, m = 0;
+    long    l = 0;
+    char    sname[CHLEN+5], opts[EXPLEN+160], line[EXPLEN+160];
+    FILE    *fp;
+    
+    sprintf(sname, "%s.sum", name);
+    if ( (fp = wr ? out_open(sname, "w") : fopen(sname, "r")) == NULL)
+        return 0;
+    sum_opts(opts);
+    if (wr)
+    {
+        fprintf(fp, "# spec_conv checksums: spectra bytes/spectrum, options\n"
+                "%d %ld\n%s\n", mxsp, len, opts);
+        for (i = 0; i < mxsp; i++) fprintf(fp, "%d %016llx\n", i, sum[i]);
+        return (out_close(fp) == 0) ? mxsp : 0;
+    }
+    skip_hash(fp);
+    if (fscanf(fp, "%d %ld", &m, &l) == 2 && m == mxsp && l == len)
+    {
+        /*rest of the line, then the options*/
+        get_line_file(fp, line, sizeof(line)-1);
+        get_line_file(fp, line, sizeof(line)-1);
+        if (! strcmp(line, opts))
+            while (n < mxsp && fscanf(fp, "%d %llx", &i, &sum[n]) == 2
+                    && i == n) n++;
+    }
+    fclose(fp);
+    return n;
+} /*END sum_file()*/
+
+/*==========================================================================*/
+/* sum_opts: options that change the extracted spectra, as kept with their  */
+/*           checksums                                                      */
+/****************************************************************************/
+void sum_opts(char opts[])
+{
+    sprintf(opts, "-m %c -f %d -c %d,%g,%g,%g -w %d-%d -B %d,%d,%d,%d -E %d "
+            "-P %d -N %d -A %s", MODECH[md], ofmt, rbfac, rbg[0], rbg[1], rbg[2],
+            wlo, whi, bgit, bgwin, bglls, bgout, arerr, pyrout, ! metaout, aropt);
+} /*END sum_opts()*/
+
+/*==========================================================================*/
+/* swapb2: swap 2 array elements (a 2 byte number) in place 	    	    */
+/****************************************************************************/
+void swapb2(char *buf)
+{
+    char c;
+    c = buf[1]; buf[1] = buf[0]; buf[0] = c;
+} /*END swapb2()*/
+
+/*==========================================================================*/
+/* swapb4: swap 4 array elements (a 4 byte number) in place 	    	    */
+/****************************************************************************/
+void swapb4(char *buf)
+{
+    char c;
+    c = buf[3]; buf[3] = buf[0]; buf[0] = c;
+    c = buf[2]; buf[2] = buf[1]; buf[1] = c;    
+} /*END swapb4()*/
+
+/*==========================================================================*/
+/* walk_emit: queue file name for conversion                                */
+/****************************************************************************/
+void walk_emit(char name[])
+{
+    char    rec[CHLEN];
+    
+    /*records of CHLEN (< PIPE_BUF) bytes are written and read whole,
+        even by several processes*/
+    memset(rec, 0, CHLEN);
+    strncpy(rec, name, CHLEN-1);
+    if (! walker.stop && write(walker.fd[1], rec, CHLEN) != CHLEN)
+        walker.stop = 1;
+} /*END walk_emit()*/
+
+/*==========================================================================*/
+/* walk_load: all files found, sorted, as from load_lst()                   */
+/****************************************************************************/
+char **walk_load(int *n)
+{
+    int     mx = 1024;
+    char    name[CHLEN], **names;
+    
+    *n = 0;
+    if ( (names = (char **) malloc(mx*sizeof(char *))) == NULL) return NULL;
+    while (walk_next(name) == 0)
+    {
+        if (*n == mx)
+        {
+            mx *= 2;
+            if ( (names = (char **) realloc(names, mx*sizeof(char *))) == NULL)
+                return NULL;
+        }
+        names[(*n)++] = strdup(name);
+    }
+    qsort(names, *n, sizeof(char *), jnl_cmp);
+    printf("\n\tFound %d spectrum files\n\n", *n);
+    return names;
+} /*END walk_load()*/
+
+/*==========================================================================*/
+/* walk_match: 1 if file name found in a directory or by a pattern is to be */
+/*             converted, else 0                                            */
+/****************************************************************************/
+int walk_match(char name[])
+{
+    extern char ext[NUMOPT][11], exti[NUMOPT][11], fmti[NUMOPT][14];
+    extern char oext[NUMOFMT][11];
+    static char *side[] = {".tmp", ".jnl", ".fail", ".json", ".pyr", ".idx",
+        ".sum", ".csv", NULL};
+    int     i, j, k, f = 0, n = strlen(name);
+    char    *b = strrchr(name, '/') ? strrchr(name, '/') + 1 : name;
+    
+    /*hidden files, unfinished outputs, sidecars and tables*/
+    if (b[0] == '.') return 0;
+    for (i = 0; side[i] != NULL; i++)
+        if (n > (k = strlen(side[i])) && ! strcmp(name + n - k, side[i]))
+            return 0;
+    
+    /*without filters any recognised spectrum but this run's outputs and
+        those of the formats that are only ever written (.npy, .spt, ...),
+        which earlier runs may have left among the inputs*/
+    if (walker.nflt == 0)
+    {
+        k = strlen(ext[walker.md-1]);
+        if (n > k && ! strcmp(name + n - k, ext[walker.md-1])) return 0;
+        for (i = 0; i < NUMOFMT; i++)
+        {
+            for (j = 0; j < NUMOPT && strcmp(oext[i], exti[j]); j++) ;
+            k = strlen(oext[i]);
+            if (j == NUMOPT && n > k && ! strcmp(name + n - k, oext[i]))
+                return 0;
+        }
+        return sniff_fmt(name) > 0;
+    }
+    for (i = 0; i < walker.nflt; i++)
+    {
+        k = strlen(walker.flt[i]);
+        if (walker.flt[i][0] == '.')
+        {
+            if (n > k && ! strcmp(name + n - k, walker.flt[i])) return 1;
+        }
+        else
+        {
+            if (f == 0) f = sniff_fmt(name);
+            if (f > 0 && ! strcasecmp(walker.flt[i], fmti[f-1])) return 1;
+        }
+    }
+    return 0;
+} /*END walk_match()*/
+
+/*==========================================================================*/
+/* walk_next: next file found into name, 0 if found, -1 when all are found  */
+/****************************************************************************/
+int walk_next(char name[])
+{
+    char    rec[CHLEN];
+    
+    /*the search starts with the first name wanted, after workers fork*/
+    if (walker.nthr == 0 && getpid() == walker.pid) walk_run();
+    if (read(walker.fd[0], rec, CHLEN) != CHLEN) return -1;
+    rec[CHLEN-1] = '\0';
+    strcpy(name, rec);
+    return 0;
+} /*END walk_next()*/
+
+/*==========================================================================*/
+/* walk_push: add a directory ('d'), pattern ('g') or file ('f') to search  */
+/****************************************************************************/
+void walk_push(char item[], char type)
+{
+    pthread_mutex_lock(&walker.lock);
+    if (walker.n == walker.mx)
+    {
+        walker.mx *= 2;
+        walker.item = (char **) realloc(walker.item, walker.mx*sizeof(char *));
+        walker.type = (char *) realloc(walker.type, walker.mx);
+    }
+    if (walker.item != NULL && walker.type != NULL)
+    {
+        walker.item[walker.n] = strdup(item);
+        walker.type[walker.n++] = type;
+    }
+    pthread_cond_signal(&walker.cv);
+    pthread_mutex_unlock(&walker.lock);
+} /*END walk_push()*/
+
+/*==========================================================================*/
+/* walk_run: start the threads searching the inputs                         */
+/****************************************************************************/
+void walk_run(void)
+{
+    int     i;
+    
+    walker.left = 0;
+    for (walker.nthr = 0; walker.nthr < NWTHR; walker.nthr++)
+    {
+        pthread_mutex_lock(&walker.lock);
+        i = pthread_create(&walker.tid[walker.nthr], NULL, walk_thread, NULL);
+        if (i == 0) walker.left++;
+        pthread_mutex_unlock(&walker.lock);
+        if (i != 0) break;
+    }
+    /*no thread: nothing will be found*/
+    if (walker.nthr == 0)
+    {
+        walker.nthr = -1;
+        close(walker.fd[1]);
+        walker.fd[1] = -1;
+    }
+} /*END walk_run()*/
+
+/*==========================================================================*/
+/* walk_start: search the n files, directories and patterns in[] for the    */
+/*             spectra of mode md, queued as they are found                 */
+/****************************************************************************/
+int walk_start(int n, char *in[])
+{
+    extern int md;
+    extern char exti[NUMOPT][11], fmti[NUMOPT][14];
+    int     i, j;
+    char    flt[CHLEN], *p;
+    struct  stat statbuf;
+    
+    if (md == NUMOPT)
+    {
+        printf("Gainmatching needs a list file of names and coefficients\n");
+        return -1;
+    }
+    
+    /*filters: extensions (.xxx) or format names, else the mode's input
+        extension, or any recognised format for modes that take any*/
+    strcpy(flt, walkflt);
+    walker.nflt = 0;
+    for (p = strtok(flt, ","); p != NULL; p = strtok(NULL, ","))
+    {
+        if (walker.nflt == NWFLT || strlen(p) > 15)
+        {
+            printf("Too many or too long input filters: %s\n", walkflt);
+            return -1;
+        }
+        for (j = 0; p[0] != '.' && j < NUMOPT && strcasecmp(p, fmti[j]); j++) ;
+        if (j == NUMOPT)
+        {
+            printf("Unknown input format: %s\n", p);
+            return -1;
+        }
+        strcpy(walker.flt[walker.nflt++], p);
+    }
+    if (walker.nflt == 0 && md != 12 && md != 13 && md != 14 && md != 16)
+        strcpy(walker.flt[walker.nflt++], exti[md-1]);
+    
+    walker.mx = n > 64 ? n : 64;
+    walker.item = (char **) malloc(walker.mx*sizeof(char *));
+    walker.type = (char *) malloc(walker.mx);
+    if (walker.item == NULL || walker.type == NULL || pipe(walker.fd) < 0)
+    {
+        printf("Cannot search for input files\n");
+        return -1;
+    }
+    pthread_mutex_init(&walker.lock, NULL);
+    pthread_cond_init(&walker.cv, NULL);
+    walker.n = walker.busy = walker.stop = walker.nthr = 0;
+    walker.desc[0] = '\0';
+    
+    /*in order: the stack is searched from the top*/
+    for (i = n - 1; i >= 0; i--)
+    {
+        if (! stat(in[i], &statbuf)) walk_push(in[i],
+                S_ISDIR(statbuf.st_mode) ? 'd' : 'f');
+        else walk_push(in[i], strpbrk(in[i], "*?[") ? 'g' : 'f');
+    }
+    for (i = 0; i < n; i++)
+    {
+        j = strlen(walker.desc);
+        snprintf(walker.desc + j, sizeof(walker.desc) - j, "%s%s",
+                i ? " " : "", in[i]);
+    }
+    
+    /*a write to a queue nobody reads fails instead of ending the program*/
+    signal(SIGPIPE, SIG_IGN);
+    walker.md = md;
+    walker.pid = getpid();
+    walker.on = 1;
+    printf("Searching %s for %s files\n", walker.desc,
+            walker.nflt ? (strlen(walkflt) ? walkflt : exti[md-1]) : "spectrum");
+    return 0;
+} /*END walk_start()*/
+
+/*==========================================================================*/
+/* walk_stop: stop searching and free the queue                             */
+/****************************************************************************/
+void walk_stop(void)
+{
+    int     i;
+    
+    if (! walker.on) return ;
+    /*threads still writing see the queue closed*/
+    pthread_mutex_lock(&walker.lock);
+    walker.stop = 1;
+    close(walker.fd[0]);
+    pthread_cond_broadcast(&walker.cv);
+    pthread_mutex_unlock(&walker.lock);
+    if (getpid() == walker.pid)
+        for (i = 0; i < walker.nthr; i++) pthread_join(walker.tid[i], NULL);
+    if (walker.fd[1] >= 0) close(walker.fd[1]);
+    for (i = 0; i < walker.n; i++) free(walker.item[i]);
+    free(walker.item);
+    free(walker.type);
+    pthread_mutex_destroy(&walker.lock);
+    pthread_cond_destroy(&walker.cv);
+    walker.on = 0;
+} /*END walk_stop()*/
+
+/*==========================================================================*/
+/* walk_thread: search inputs from the stack until all are searched,        */
+/*              queueing the files to convert                               */
+/****************************************************************************/
+void *walk_thread(void *arg)
+{
+    int     i, k;
+    char    *item, type, name[CHLEN];
+    glob_t  gl;
+    DIR     *dp;
+    struct  dirent *de;
+    struct  stat statbuf;
+    
+    while (1)
+    {
+        /*wait for an input while other threads may still add some*/
+        pthread_mutex_lock(&walker.lock);
+        while (walker.n == 0 && walker.busy > 0 && ! walker.stop)
+            pthread_cond_wait(&walker.cv, &walker.lock);
+        if (walker.n == 0 || walker.stop)
+        {
+            /*the last one out ends the queue*/
+            if (--walker.left == 0)
+            {
+                close(walker.fd[1]);
+                walker.fd[1] = -1;
+            }
+            pthread_cond_broadcast(&walker.cv);
+            pthread_mutex_unlock(&walker.lock);
+            return NULL;
+        }
+        item = walker.item[--walker.n];
+        type = walker.type[walker.n];
+        walker.busy++;
+        pthread_mutex_unlock(&walker.lock);
+        
+        /*files named are converted whatever the filters*/
+        if (type == 'f') walk_emit(item);
+        else if (type == 'g')
+        {
+            if ( (i = glob(item, 0, NULL, &gl)) == GLOB_NOMATCH)
+                printf("No files match %s\n", item);
+            for (k = 0; i == 0 && k < gl.gl_pathc && ! walker.stop; k++)
+            {
+                if (strlen(gl.gl_pathv[k]) >= CHLEN
+                    || stat(gl.gl_pathv[k], &statbuf)) continue;
+                if (S_ISDIR(statbuf.st_mode)) walk_push(gl.gl_pathv[k], 'd');
+                else if (S_ISREG(statbuf.st_mode) && walk_match(gl.gl_pathv[k]))
+                    walk_emit(gl.gl_pathv[k]);
+            }
+            if (i == 0) globfree(&gl);
+        }
+        else if ( (dp = opendir(item)) == NULL)
+            printf("Cannot open directory: %s\n", item);
+        else
+        {
+            k = strlen(item);
+            while ( (de = readdir(dp)) != NULL && ! walker.stop)
+            {
+                if (de->d_name[0] == '.') continue;
+                if (snprintf(name, CHLEN, "%s%s%s", item,
+                        item[k-1] == '/' ? "" : "/", de->d_name) >= CHLEN)
+                {
+                    printf("Name too long: %s/%s ...skipped\n", item, de->d_name);
+                    continue;
+                }
+                /*linked directories are not followed: they may loop*/
+                if (lstat(name, &statbuf)) continue;
+                if (S_ISDIR(statbuf.st_mode)) walk_push(name, 'd');
+                else if ( (S_ISREG(statbuf.st_mode) || (S_ISLNK(statbuf.st_mode)
+                        && ! stat(name, &statbuf) && S_ISREG(statbuf.st_mode)))
+                        && walk_match(name)) walk_emit(name);
+            }
+            closedir(dp);
+        }
+        free(item);
+        
+        pthread_mutex_lock(&walker.lock);
+        walker.busy--;
+        pthread_cond_broadcast(&walker.cv);
+        pthread_mutex_unlock(&walker.lock);
+    }
+    return NULL;
+} /*END walk_thread()*/
+
+/*==========================================================================*/
+/* win_crop: zero channels outside the window, return the channels to write */
+/****************************************************************************/
+int win_crop(int numch)
+{
+    int     i;
+    
+    if (whi < 0) return numch;
+    for (i = 0; i < wlo && i < numch; i++) spectrum[i] = 0.0;
+    for (i = whi + 1; i < numch; i++) spectrum[i] = 0.0;
+    return numch < whi + 1 ? numch : whi + 1;
+} /*END win_crop()*/
+
+/*==========================================================================*/
+/* win_read: read only the channel window of a RadWare or .Chn spectrum     */
+/*  with pread(), return channels in the file or 0 to read it in full       */
+/****************************************************************************/
+int win_read(char name[], int md)
+{
+    int     i, fd, ch, off = 0, swap = 0, hdr, lo, hi;
+    int     *buf;
+    
+    /*inline input is already in memory*/
+    if (memfile.buf && ! strcmp(memfile.name, name)) return 0;
+    if ( (fd = open(name, O_RDONLY)) < 0) return 0;
+    
+    /*Chn: counts (int) from channel maest_header.off follow the header;
+        RadWare: floats after the header with its record lengths*/
+    if (md == 4 || md == 5)
+    {
+        hdr = sizeof(maest_header);
+        if (pread(fd, &maest_header, hdr, 0) != hdr)
+        {
+            close(fd);
+            return 0;
+        }
+        ch = maest_header.channels;
+        off = maest_header.off;
+        if (ch > CHMAX || ch < cswap2(CHMAX))
+        {
+            swap = 1;
+            ch = cswap2(ch);
+            off = cswap2(off);
+        }
+    }
+    else
+    {
+        hdr = sizeof(radheader);
+        if (pread(fd, &radheader, hdr, 0) != hdr)
+        {
+            close(fd);
+            return 0;
+        }
+        ch = radheader.channels;
+        if (ch > CHMAX)
+        {
+            swap = 1;
+            ch = cswap4(ch);
+        }
+    }
+    if (ch <= 0 || ch > CHMAX || off < 0 || off >= CHMAX)
+    {
+        close(fd);
+        return 0;
+    }
+    if (ch + off > CHMAX) ch = CHMAX - off;
+    
+    /*file positions of the window*/
+    lo = wlo > off ? wlo - off : 0;
+    hi = whi - off < ch - 1 ? whi - off : ch - 1;
+    if (hi >= lo && (buf = (int *) malloc((hi - lo + 1)*sizeof(int))) != NULL)
+    {
+        if (pread(fd, buf, (hi - lo + 1)*sizeof(int), hdr + (long)lo*sizeof(int))
+                != (hi - lo + 1)*sizeof(int))
+        {
+            printf("Error reading file: %s \n", name);
+            free(buf);
+            close(fd);
+            return -1;
+        }
+        for (i = 0; i <= hi - lo; i++)
+        {
+            if (swap) swapb4( (char *) (buf + i) );
+            if (md == 4 || md == 5) spectrum[lo + off + i] = (float)buf[i];
+            else spectrum[lo + off + i] = *(float *)(buf + i);
+        }
+        free(buf);
+    }
+    close(fd);
+    printf(" Read channels %d-%d of %s\n", wlo, whi, name);
+    return ch + off;
+} /*END win_read()*/
+
+/*==========================================================================*/
+/* write_mspec: write n spectra into slots of a multiple spectrum file      */
+/****************************************************************************/
+int write_mspec(char name[], char **names, int n, int numch)
+{
+    int     fd, i, j, w, nw, nerr = 0, bmo = batch, nf = nfail;
+    long    slot = (long)numch*sizeof(unsigned int);
+    char    why[CHLEN], tmp[CHLEN+12];
+    unsigned int *buf;
+    
+    if ( (buf = (unsigned int *) malloc(slot)) == NULL)
+    {
+        printf("Cannot allocate memory for %d channels\n", numch);
+        return -1;
+    }
+    /*filled as name.tmp, renamed once every worker is done*/
+    snprintf(tmp, sizeof(tmp), "%s.tmp", name);
+    if ( (fd = open(tmp, O_RDWR | O_CREAT | O_TRUNC, 0666)) < 0)
+    {
+    	printf("Cannot open file: %s \n", name);
+        free(buf);
+	return -1;
+    }
+    /*reserve the whole file so workers can write their slots in any order*/
+    if (posix_fallocate(fd, 0, n*slot) != 0 && ftruncate(fd, n*slot) != 0)
+    {
+    	printf("Cannot allocate %ld bytes for file: %s \n", n*slot, name);
+        close(fd);
+        unlink(tmp);
+        free(buf);
+	return -1;
+    }
+    
+    batch = 1;
+    nw = get_nthr();
+    if (nw > n) nw = n;
+    w = par_fork(&nw);
+    pipe_start(names, n, w, nw, 0);
+    for (i = w; i < n; i += nw)
+    {
+        if ( (j = read_any(names[i])) < 0 || j > numch)
+        {
+            sprintf(why, "%d channels, not packed (max. %d)", j, numch);
+            fail_note(names[i], why);
+            nerr++;
+            continue;
+        }
+        /*pad with zeros to the common length*/
+        for (j = 0; j < numch; j++)
+            buf[j] = spectrum[j] > 0.0 ? (unsigned int)(spectrum[j] + 0.5) : 0;
+        if (pwrite(fd, buf, slot, i*slot) != slot)
+        {
+            sprintf(why, "cannot write spectrum %d of %s", i, name);
+            fail_note(names[i], why);
+            nerr++;
+        }
+        else printf(" %s ==> %s spectrum %d\n", names[i], name, i);
+    }
+    pipe_stop();
+    nerr = par_wait(w, nerr);
+    nfail = nf + nerr;
+    batch = bmo;
+    
+    free(buf);
+    if (close(fd) < 0 || rename(tmp, name) < 0)
+    {
+    	printf("Error writing file: %s \n", name);
+        unlink(tmp);
+	return -1;
+    }
+    printf(" ==> %s %d spectra x %d chs. (%d not packed)\n",name,n,numch,nerr);
+    return nerr > 0 ? -1 : 0;
+} /*END write_mspec()*/
+
+/*==========================================================================*/
+/* write_ofmt: call spectrum_write function for selectable output format    */
+/****************************************************************************/
+void write_ofmt(char name[], int numch, int of)
+{
+    if ( (numch = proc_stages(name, numch, -1, of)) < 0) return ;
+    jnl_out(name);
+    if (statfd >= 0) stat_spec(name, numch);
+    if (pyrout) pyr_write(name, numch);
+    if (of == 0) ascii_write(name, numch);
+    else if (of == 1) rad_write(name, numch);
+    else if (of == 2) xtrack_write(name, numch);
+    else if (of == 3) npy_write(name, numch);
+    else if (of == 4) raw_write(name, numch);
+    else if (of == 5) shm_write(name, numch);
+    else if (of == 6) sp_write(name, numch, 1);
+    else if (of == 7) sp_write(name, numch, 0);
+    else if (of == 8) chn_write(name, numch);
+    else if (of == 9) spe_write(name, numch);
+    /*raw output has the metadata in its own sidecar, .Spe in its sections*/
+    if (metaout && of != 4 && of != 5 && of != 9) meta_write(name);
+
+    return ;
+} /*END write_ofmt()*/
+
+/*==========================================================================*/
+/* write_probe: write probed metadata as CSV, or as JSON for .json names    */
+/****************************************************************************/
+int write_probe(char name[], char **names, struct specmeta *m, int n)
+{
+    int     i, j, k, json;
+    char    *ex, row[3*CHLEN + 200];
+    float   v[5];
+    FILE    *fo;
+    
+    if ( (fo = out_open(name, "w")) == NULL)
+    {
+        printf("Cannot open file: %s \n", name);
+        return -1;
+    }
+    json = ( (ex = strrchr(name,'.')) && ! strcmp(ex, ".json") );
+    
+    if (json) fprintf(fo, "[\n");
+    else fprintf(fo, "file,format,live_s,real_s,date,time,channels,offset,"
+            "cal0,cal1,cal2,name,ok\n");
+    for (i = 0; i < n; i++)
+    {
+        if (json)
+        {
+            meta_json(fo, names[i], &m[i], 0);
+            fprintf(fo, ",\"ok\":%s}%s\n", m[i].err ? "false" : "true",
+                    i < n-1 ? "," : "");
+        }
+        else
+        {
+            /*quoted where needed, unknown values left empty*/
+            v[0] = m[i].live < 0.0 ? NAN : m[i].live;
+            v[1] = m[i].real < 0.0 ? NAN : m[i].real;
+            memcpy(&v[2], m[i].cal, sizeof(m[i].cal));
+            k = csv_str(row, names[i]);
+            row[k++] = ',';
+            k += csv_str(row + k, m[i].fmt);
+            for (j = 0; j < 2; j++)
+            {
+                row[k++] = ',';
+                k += csv_num(row + k, v[j]);
+            }
+            row[k++] = ',';
+            k += csv_str(row + k, m[i].date);
+            row[k++] = ',';
+            k += csv_str(row + k, m[i].time);
+            k += sprintf(row + k, ",%d,%d", m[i].channels, m[i].off);
+            for (j = 2; j < 5; j++)
+            {
+                row[k++] = ',';
+                k += csv_num(row + k, v[j]);
+            }
+            row[k++] = ',';
+            k += csv_str(row + k, m[i].name);
+            sprintf(row + k, ",%d\n", m[i].err ? 0 : 1);
+            fputs(row, fo);
+        }
+    }
+    if (json) fprintf(fo, "]\n");
+    if (out_close(fo) != 0)
+    {
+        printf("Error writing file: %s \n", name);
+        return -1;
+    }
+    return 0;
+} /*END write_probe()*/
+
+/*==========================================================================*/
+/* write_spec: call appropriate spectrum_write function based on mode,      */
+/*             return -1 if nothing is written                              */
+/****************************************************************************/
+int write_spec(char name[], int numch, int md)
+{
+    if ( (numch = proc_stages(name, numch, md, -1)) < 0) return -1;
+    jnl_out(name);
+    if (statfd >= 0) stat_spec(name, numch);
+    if (pyrout) pyr_write(name, numch);
+    if (md == 1) ascii_write(name, numch);
+    else if (md == 2) rad_write(name, numch);
+    else if (md == 3) xtrack_write(name, numch);
+    else if (md == 4) ascii_write(name, numch);
+    else if (md == 5) rad_write(name, numch);
+    else if (md == 6) ascii_write(name, numch);
+    else if (md == 7) rad_write(name, numch);
+    else if (md == 8) rad_write(name, numch);
+    else if (md == 9) rad_write(name, numch);
+    else if (md == 10) ascii_write(name, numch);
+    else if (md == NUMOPT) rad_write(name, numch);
+    if (metaout) meta_write(name);
+
+    return 0;
+} /*END write_spec()*/
+
+/*==========================================================================*/
+/* xtrack_read: read an xtrack (GASPWARE) format spectrum   	    	    */
+/****************************************************************************/
+void xtrack_read(char name[], int *numch, int mxsp, int sz, int nsp, int flg)
+{
+    int i = 0, last_nonzero_channel = 0, mxcnts = 0, fd, n;
+    unsigned int *xtrack_spec;
+    FILE *fp;
+    
+    memset(&meta, 0, sizeof(meta));
+    meta.live = meta.real = -1.0;
+    strncpy(meta.src, name, CHLEN-1);
+    strcpy(meta.fmt, "Xtrack");
+    meta.sp = nsp;
+    meta.nsp = mxsp;
+    meta.sz = sz;
+    
+    /*channel window of a spectrum with a known layout: read just that*/
+    if (whi >= 0 && mxsp > 1 && sz == 4 && wlo < *numch
+        && (fd = open(name, O_RDONLY)) >= 0)
+    {
+        n = (whi < *numch ? whi + 1 : *numch) - wlo;
+        xtrack_spec = (unsigned int *) malloc(n*sz);
+        i = pread(fd, xtrack_spec, (long)n*sz, ((long)nsp*(*numch) + wlo)*sz);
+        close(fd);
+        if (i == n*sz)
+        {
+            for (i = 0; i < n; i++)
+                spectrum[wlo + i] = (float) (int) *(xtrack_spec + i);
+            free(xtrack_spec);
+            return ;
+        }
+        free(xtrack_spec);
+    }
+         
+    /*open xtrack file*/
+    if ((fp = spec_open(name, "r" )) == NULL)
+    {
+    	printf("Cannot open file: %s \n", name);
+    	*numch = -1;
+	return ;	    	    	    
+    }
+    
+    if (mxsp > 1 && nsp > 0) fseek(fp, (int)(nsp*(*numch)*sz), 0);
+    
+    xtrack_spec = (unsigned int *) malloc(*numch*sz);
+    
+    while ( fread(xtrack_spec, *numch*sz, 1, fp) != 1 )
+    {
+    	*numch /= 2;	    
+	printf("Trying spectrum length: %d channels\n", *numch);
+	if (*numch <= 1024)
+	{
+    	    printf("Error reading file: %s \n", name);
+	    *numch = -1;
+	    free(xtrack_spec);
+	    spec_close(fp);
+	    return ;
+	}
+    }
+    printf(" Length = %d channels was successful\n", *numch);
+	        
+    for (i = 0; i < *numch; i++)
+    {
+	/*Note that in the conversion int is necessary first to get the
+	    	sign correct*/
+	spectrum[i] = (float) (int) *(xtrack_spec + i);
+/*	printf("i = %d spectrum[i] = %f\n", i, spectrum[i]); */
+	
+	if (spectrum[i] != 0) last_nonzero_channel = i;
+	
+	if (spectrum[i] > mxcnts) mxcnts = (int) spectrum[i];
+	
+    }
+    
+    if (mxcnts > 10000000)    /*Probably not an Xtrack format spectrum*/
+    {
+	printf("***WRONG FORMAT. NOT AN XTRACK SPECTRUM***\n");
+	*numch = -1;
+	free(xtrack_spec);
+	spec_close(fp);
+	return ;
+    }
+    
+    /*only remove zeroes if not multiple spectrum file or list*/
+    if (flg != 1)
+    {
+    	while (last_nonzero_channel < (*numch/2) && *numch >= 1024) *numch /= 2;
+    	printf("Real length of spectrum (after removing zeros) = %d channels\n",
+	    *numch);
+    }
+/*    else printf("Length of spectrum = %d channels\n",*numch);*/
+       
+    free(xtrack_spec);
+    spec_close(fp);
+    return ; 
+    
+} /*END xtrack_read()*/
+
+/*==========================================================================*/
+/* xtrack_write: write a (GASPWARE) format spectrum    	    	    	    */
+/****************************************************************************/
+void xtrack_write(char name[], int numch)
+{
+    int i = 0;
+    unsigned int tmp_spec[CHMAX];
+    unsigned int numbytes;
+    FILE *fsp;
+         
+    /*open .spec write only file*/
+    if ( (fsp = spec_open(name, "w" )) == NULL)
+    {
+    	printf("Cannot open file: %s \n", name);
+	return ; 
+    } 	    	    
+
+    numbytes = numch*sizeof(unsigned int);
+        
+    for (i = 0; i < numch; i++) tmp_spec[i] = (unsigned int)spectrum[i];
+    
+    fwrite(&tmp_spec, numbytes, 1, fsp);
+
+    printf(" ==> %s %d chs.\n", name, numch);
+    
+    spec_close(fsp);
+} /*END xtrack_write()*/